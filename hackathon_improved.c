@@ -1,12 +1,45 @@
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     @LIBRARIES
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#if defined(__STRICT_ANSI__) && !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L // -std=c99 otherwise hides clock_gettime, fileno, sigaction...
+#endif
 #include <stdio.h>
 #include <stdbool.h>
 #include <time.h>
 #include <string.h>
 #include <stdlib.h>
-#include <windows.h> // Added for Windows-specific functions
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
+#include <ctype.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define KEY_SIMD 1 // SSE2/AVX2 substring kernels, picked at runtime
+#else
+#define KEY_SIMD 0
+#endif
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>     // Parallel scan pool
+#else
+#include <windows.h> // File mapping, performance counter, console API and threads
+#include <io.h>
+#endif
+#ifdef __linux__
+#include <sys/epoll.h>   // Server mode
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <signal.h>
+#include <errno.h>
+#endif
+#include "library_bench.h" // --bench workload, shared with hackathon_improved_linked-list.c
 
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     @MACROS
@@ -22,45 +55,697 @@
 // Enum for status types
 enum bookStatus {AVAILABLE = 1, CHECKED_OUT = 0};
 
-// Declare book data structure as 'book'
-typedef struct Book {
-    char title[50];
-    char author[50];
-    char isbn[20];
-    enum bookStatus status;
-} book;
+// Lower-cased copy of a searchable field, built once when the book is stored
+typedef struct FoldedKey {
+    uint32_t hash;     // FNV-1a hash of the folded bytes
+    uint8_t length;    // Number of folded bytes, excluding the terminator
+    char text[50];     // Folded field, NUL-terminated
+} foldedKey;
+
+#define CATALOG_INITIAL_CAPACITY 64
+#define STORE_RESERVE_BOOKS 4096 // Most books Add Books reserves room for before they are typed
+#define KEY_SIMD_PADDING 64 // Slack after each key column for unaligned vector loads
+
+#define CATALOG_DEFAULT_PATH "library.dat"
+#define CATALOG_MAGIC "BOOKCAT"  // 8 bytes with the terminator
+#define CATALOG_VERSION 2        // 2: ISBNs stored as integers
+#define CATALOG_ALIGN 64         // Every column starts on a 64-byte boundary
+
+// Catalog columns, in the order they are laid out in the catalog file
+enum catalogColumn {
+    COLUMN_TITLES,
+    COLUMN_AUTHORS,
+    COLUMN_ISBNS,
+    COLUMN_TITLE_KEYS,
+    COLUMN_AUTHOR_KEYS,
+    COLUMN_TITLE_ORDER,
+    COLUMN_AUTHOR_ORDER,
+    COLUMN_AVAILABLE,
+    COLUMN_COUNT
+};
+
+// Header at the start of a catalog file. Every column after it is a
+// fixed-width array sized for `capacity` books, so the file is used in place
+// through a memory mapping with no parse step. Integers are in host order.
+typedef struct CatalogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t keySize;        // sizeof(foldedKey) when the file was written
+    uint32_t count;          // Committed books; later slots are ignored
+    uint32_t capacity;
+    uint32_t indexedCount;   // Books covered by the order columns, 0 while rewriting them
+    uint8_t padding[4];      // Keeps isbnSequence 8-byte aligned
+    uint64_t isbnSequence;   // Next sequence number for the ISBN allocator
+    uint8_t reserved[24];
+} catalogHeader;
+
+_Static_assert(sizeof(catalogHeader) == CATALOG_ALIGN, "catalog header must fill one column slot");
+
+// Read/write memory mapping of a whole file
+typedef struct MappedFile {
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+    char* base;
+    size_t size;
+} mappedFile;
+
+// Substring kernel: does the folded needle occur in the folded haystack?
+typedef bool (*containsFn)(const char* hay, size_t hayLen, const char* needle, size_t needleLen);
+
+// Columnar book catalog: one contiguous array per field, so a scan that only
+// needs one field (e.g. counting checked-out books) only touches that column
+typedef struct Catalog {
+    char (*titles)[50];
+    char (*authors)[50];
+    uint64_t* isbns;        // ISBN-13 as a 13-digit integer, formatted only for display
+    foldedKey* titleKeys;   // Search keys for titles, kept in sync by store
+    foldedKey* authorKeys;  // Search keys for authors, kept in sync by store
+    int* titleOrder;        // Positions sorted by title key (see sortedIndex)
+    int* authorOrder;       // Positions sorted by author key
+    uint64_t* available;    // Status bitmap, bit set = AVAILABLE; words change by CAS only
+    int count;
+    int capacity;
+    int indexedCount;       // Books already merged into the order columns
+    uint64_t isbnSequence;  // Next sequence number for generateISBN
+    bool persistent;        // Columns live in `file` rather than on the heap
+    mappedFile file;
+} catalog;
+
+#define WAL_SUFFIX ".wal"            // The log sits next to the catalog file
+#define WAL_MAGIC "BOOKWAL"          // 8 bytes with the terminator
+#define WAL_VERSION 2
+#define WAL_GROUP_RECORDS 256        // Pending records before a commit is forced
+#define WAL_CHECKPOINT_BYTES (4u << 20) // Fold the log into the catalog past this size
+
+// Header at the start of the write-ahead log
+typedef struct WalHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;     // sizeof(walRecord) when the log was written
+} walHeader;
+
+// One status transition in the write-ahead log
+typedef struct WalRecord {
+    uint64_t isbn;           // ISBN-13 of the book
+    int64_t timestamp;       // Unix time of the transition
+    uint32_t position;       // Catalog position when logged, checked against the ISBN on replay
+    uint8_t oldStatus;
+    uint8_t newStatus;
+    uint8_t reserved[6];
+    uint32_t checksum;       // FNV-1a over the bytes before this field
+} walRecord;
+
+_Static_assert(sizeof(walRecord) == 32, "log records must have no padding");
+
+// Append-only log of check-outs and returns. Records are buffered and
+// written with a single fsync per group, so the catalog file itself is
+// only flushed at a checkpoint.
+typedef struct WalLog {
+    FILE* file;              // NULL when the catalog is not file-backed
+    char* path;
+    walRecord pending[WAL_GROUP_RECORDS];
+    int pendingCount;
+    size_t size;             // Bytes in the log file, header included
+} walLog;
+
+#define ISBN_INDEX_INITIAL_CAPACITY 256 // Must be a power of two
+
+#define ISBN_TEXT_SIZE 16               // "979-123456789-7" and the terminator
+#define ISBN_INPUT_SIZE 32              // Typed ISBN, with room for hyphens and spaces
+#define ISBN_GENERATED_PREFIX 979ULL    // Generated ISBNs are 979, 9 digits, check digit
+#define ISBN_BODY_SPACE 1000000000u     // Values of the 9 digits after the prefix
+#define ISBN_SCRAMBLE_HALF_BITS 15      // Scramble works on 30 bits, just above ISBN_BODY_SPACE
+#define ISBN_SCRAMBLE_ROUNDS 4
+#define ISBN_SCRAMBLE_KEY 0x9e3779b97f4a7c15ULL
+#define ISBN_RANGE_BLOCK 1024           // Sequence numbers a loader takes from the catalog at a time
+
+#define OUTPUT_BUFFER_SIZE (1 << 20) // Bytes rendered before each write to stdout
+
+// Render buffer for long listings: records are formatted into `data` and
+// written to stdout with one write per full buffer instead of one printf
+// per field
+typedef struct OutputBuffer {
+    char* data;
+    size_t length;
+    size_t capacity;
+    bool color;              // Emit ANSI colors; off when stdout is not a terminal
+    bool grow;               // Grow when full instead of writing to stdout (server clients)
+} outputBuffer;
+
+// Open-addressing hash index slot keyed on the ISBN-13
+typedef struct IsbnSlot {
+    uint64_t key;    // ISBN-13 as an integer
+    int index;       // Position in the catalog, -1 if slot is empty
+} isbnSlot;
+
+// Hash index used for O(1) ISBN lookups at the checkout desk
+typedef struct IsbnIndex {
+    isbnSlot* slots;
+    size_t capacity; // Always a power of two
+    size_t count;
+} isbnIndex;
+
+// Block of ISBN sequence numbers [next, end) handed to one loader. Every
+// sequence number maps to a distinct ISBN, so loaders with their own
+// ranges never hand out the same ISBN.
+typedef struct IsbnRange {
+    uint64_t next;
+    uint64_t end;
+} isbnRange;
+
+// Sorted secondary index over one text field, compared case-insensitively.
+// Both arrays are catalog columns, so the order is saved with the catalog.
+typedef struct SortedIndex {
+    int* const* order;       // Book positions ordered by (folded key, position)
+    foldedKey* const* keys;  // Catalog key column this index orders
+    size_t count;
+} sortedIndex;
+
+// Half-open range [first, last) of positions inside a sorted index
+typedef struct IndexRange {
+    size_t first;
+    size_t last;
+} indexRange;
+
+#define PAGE_SIZE_DEFAULT 10  // Books per page when browsing the catalog
+#define PAGE_SIZE_MAX 1000
+
+// Cursor over the rows of one listing: the books in the order they were
+// added, or the books in the order of a sorted index. A cursor can cover
+// any range of an index (e.g. a prefix match) and hands out one book
+// position at a time, so callers never walk rows they do not show.
+typedef struct CatalogCursor {
+    const sortedIndex* idx;  // NULL walks books in the order they were added
+    size_t first;            // Rows [first, last) of the listing
+    size_t last;
+    size_t position;         // Next row to return
+} catalogCursor;
+
+// One search match: where the book is and how well it matched
+typedef struct SearchHit {
+    int position;
+    uint32_t score;    // Higher is better; see matchScore
+} searchHit;
+
+// The best matches of one search. While the index is scanned the hits form
+// a min-heap with the weakest kept match on top, so a top-K search keeps K
+// positions no matter how many books match; resultFinish sorts them best
+// first. Only book positions are stored, never copies of the books.
+typedef struct SearchResult {
+    searchHit* hits;
+    size_t count;      // Hits kept
+    size_t capacity;
+    size_t limit;      // Keep at most this many; 0 keeps every match
+    size_t total;      // Every match seen, kept or not
+} searchResult;
+
+#define SEARCH_DEFAULT_LIMIT 20  // Matches listed by an interactive search
+
+#define SCAN_CHUNK_ROWS 16384    // Rows per work item of a parallel scan, a multiple of 64
+#define SCAN_MAX_THREADS 64
+#define SCAN_MIN_ROWS (4 * SCAN_CHUNK_ROWS) // Smaller scans run on the calling thread
+
+// Scan rows [first, last) of the catalog and offer each match to res
+typedef void (*scanChunkFn)(const void* arg, int first, int last, searchResult* res);
+
+// The chunks one scan thread still has to do. Head and tail share one word,
+// so the owner taking from the head and a thief taking from the tail agree
+// with a single compare-and-swap.
+typedef struct ScanQueue {
+    uint64_t range;          // Next chunk in the low 32 bits, end in the high 32
+    char padding[56];        // One queue per cache line
+} scanQueue;
+
+// Thread pool for scans no index can answer. The calling thread works as
+// thread 0; the others sleep between scans. Each thread keeps its own top-K
+// and the results are merged at the end, so a scan takes no lock per match.
+typedef struct ScanPool {
+    int threads;             // Threads per scan, the caller included
+    bool started;
+    scanChunkFn fn;          // The scan being run
+    const void* arg;
+    int count;
+    size_t limit;
+    uint64_t generation;     // Bumped to start a scan
+    int running;             // Helper threads still working on it
+    scanQueue queues[SCAN_MAX_THREADS];
+    searchResult results[SCAN_MAX_THREADS];
+#ifdef _WIN32
+    SRWLOCK lock;
+    CONDITION_VARIABLE wake;
+    CONDITION_VARIABLE done;
+#else
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+#endif
+} scanPool;
+
+// What a key scan looks for; see scanKeysChunk
+typedef struct KeyScan {
+    const foldedKey* keys;
+    const foldedKey* query;  // NULL matches every key
+    const uint64_t* available; // Only checked-out books if not NULL
+} keyScan;
+
+#define TRIGRAM_BUCKETS (1 << 16) // Trigram hash buckets; a collision only adds candidates
+
+// Positions of the books whose key contains one trigram, ascending
+typedef struct TrigramPostings {
+    int* positions;
+    uint32_t count;
+    uint32_t capacity;
+} trigramPostings;
+
+// Inverted index from the trigrams of one key column to the books that
+// contain them, for typo-tolerant search. Books are only ever appended, so
+// trigramIndexSync indexes just the books added since its last call and
+// every posting list stays sorted.
+typedef struct TrigramIndex {
+    trigramPostings* buckets;  // TRIGRAM_BUCKETS lists
+    int count;                 // Books [0, count) are indexed
+    uint8_t* shared;           // Per-book count of query trigrams, zero between queries
+    int sharedCapacity;
+} trigramIndex;
+
+#define WORD_INDEX_INITIAL_CAPACITY 1024 // Must be a power of two
+#define POSTING_BLOCK 64                 // Book IDs per compressed posting block
+#define POSTING_END INT_MAX              // Cursor value once a posting list is used up
+#define WORD_QUERY_TERMS 16              // Words in one title-words query
+
+// Start of every posting block after the first, so a cursor can jump to
+// the block holding an ID without decoding the blocks before it
+typedef struct PostingSkip {
+    int first;         // First ID of the block
+    uint32_t offset;   // Byte offset of the block in the encoded list
+} postingSkip;
+
+// Ascending book IDs of one word, delta + varint encoded. Each block of
+// POSTING_BLOCK IDs starts with its first ID in full, the rest are gaps to
+// the previous ID in 7-bit groups, so most IDs take one or two bytes.
+typedef struct PostingList {
+    uint8_t* bytes;
+    uint32_t length;
+    uint32_t capacity;
+    postingSkip* skips;    // Blocks 1..n-1; block 0 starts at offset 0
+    uint32_t skipCapacity;
+    uint32_t count;        // IDs in the list
+    int last;              // Last ID appended
+} postingList;
+
+// One distinct title word and the books whose title contains it
+typedef struct WordEntry {
+    uint32_t hash;
+    uint32_t wordOffset;   // Into wordIndex.text
+    uint8_t wordLength;
+    postingList books;
+} wordEntry;
+
+// Inverted index from the words of the folded titles to the books holding
+// them. Words live in an open-addressing table; as with the trigram index,
+// books are only appended, so wordIndexSync just indexes the new ones.
+typedef struct WordIndex {
+    int32_t* slots;        // Entry number per slot, -1 when empty
+    size_t capacity;       // Always a power of two
+    wordEntry* entries;
+    size_t entryCount;
+    size_t entryCapacity;
+    char* text;            // Every distinct word, back to back
+    size_t textLength;
+    size_t textCapacity;
+    int count;             // Books [0, count) are indexed
+} wordIndex;
+
+// Read position inside one posting list
+typedef struct PostingCursor {
+    const postingList* list;
+    uint32_t index;        // Position of the current ID in the list
+    uint32_t offset;       // Byte offset of the next ID
+    int value;             // Current ID, or POSTING_END
+} postingCursor;
+
+// Everything a batch or server command can read or change
+typedef struct BatchSession {
+    catalog* cat;
+    walLog* wal;
+    isbnIndex* isbnIdx;
+    sortedIndex* titleIdx;
+    sortedIndex* authorIdx;
+    trigramIndex* titleGrams;
+    trigramIndex* authorGrams;
+    wordIndex* words;
+} batchSession;
+
+#define BATCH_LINE_SIZE 512      // Longest command line in batch mode
+#define BATCH_GROUP_COMMANDS 1024 // Commands per log commit and output flush in batch mode
+
+#define SERVER_MAX_EVENTS 256           // Ready sockets handled per loop iteration
+#define SERVER_BACKLOG 512
+#define CLIENT_INPUT_SIZE (4 * BATCH_LINE_SIZE)
+#define CLIENT_OUTPUT_INITIAL 4096
+#define CLIENT_OUTPUT_LIMIT (8 << 20)    // Stop reading from a client this far behind
+
+// One connected desk in server mode. Requests are read into `input` and
+// run line by line; replies wait in `out` until the loop's group commit.
+typedef struct ServerClient {
+    int fd;
+    char input[CLIENT_INPUT_SIZE];
+    size_t inputLength;
+    bool discarding;         // Dropping the rest of an over-long line
+    bool closing;            // Peer finished sending; close once replies are out
+    bool pending;            // Already queued for the end-of-iteration write
+    bool writable;           // Waiting for EPOLLOUT instead of EPOLLIN
+    outputBuffer out;
+    size_t sent;             // Bytes of `out` already written
+    struct ServerClient* prev;
+    struct ServerClient* next;
+} serverClient;
+
+#define IMPORT_BUFFER_SIZE (1 << 20) // Bytes read from an import file at a time
+#define IMPORT_MAX_FIELDS 16
+
+// Buffered reader for CSV/TSV import files. Rows are split in place, so
+// fields point straight into `buffer` and nothing is copied until the
+// book is appended to the catalog.
+typedef struct ImportReader {
+    FILE* file;
+    char* buffer;
+    size_t capacity;         // Usable bytes; one more is kept for a terminator
+    size_t start;            // First byte not yet returned as part of a row
+    size_t end;              // One past the last byte read
+    char delimiter;          // ',' or '\t'
+    bool eof;
+} importReader;
+
+#define STATS_SUB_BITS 4                       // Each power of two is split into 2^4 buckets
+#define STATS_SUB_BUCKETS (1 << STATS_SUB_BITS)
+#define STATS_BUCKETS ((64 - STATS_SUB_BITS + 1) * STATS_SUB_BUCKETS)
+#define STATS_MAX_THREADS 128                  // Threads that can record timings
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL _Thread_local // Other compilers need C11
+#endif
+
+// Operations timed into the latency histograms, whether they come from
+// the menu, a batch file or a server connection
+enum statOp {
+    STAT_ADD, STAT_MERGE, STAT_ISBN, STAT_TITLE, STAT_AUTHOR, STAT_CONTAINS,
+    STAT_FUZZY, STAT_WORDS, STAT_CHECKEDOUT, STAT_CHECKOUT, STAT_RETURN, STAT_OPS
+};
+
+// Log-linear latency histogram in nanoseconds, in the style of
+// HdrHistogram: below 32 ns every value has its own bucket, above that
+// each power of two is split into 16, so a latency is placed within 6.25%
+typedef struct LatencyHistogram {
+    uint64_t counts[STATS_BUCKETS];
+    uint64_t max;      // Exact, in nanoseconds
+    uint64_t count;    // Filled in by statsCollect
+} latencyHistogram;
+
+// One thread's histograms. Only the owning thread writes them, and the
+// stats command reads them with atomic loads, so recording never takes a
+// lock and reporting never holds up the threads that record.
+typedef struct ThreadStats {
+    latencyHistogram ops[STAT_OPS];
+} threadStats;
+
+// Bytes held by the catalog and its in-memory indexes
+typedef struct MemoryUsage {
+    size_t catalog;    // Columns, or the whole mapping when file-backed
+    size_t isbnIndex;
+    size_t trigrams;   // Title and author trigram indexes
+    size_t words;      // Title word index
+} memoryUsage;
+
+// What the console on stdout can do, detected once by terminalInit
+typedef struct TerminalInfo {
+    bool isTerminal;  // stdout is a console rather than a file or pipe
+    bool ansi;        // The console understands ANSI escape sequences
+} terminalInfo;
+
+// Substring kernel chosen for this CPU by initContainsKernel
+static containsFn containsKernel = NULL;
+
+// Threads for unindexed scans; the size is set with --threads, by default
+// one per processor
+static scanPool scanEngine;
+
+// Nanoseconds per statsClock tick, measured by statsInit
+static double statsNanosPerTick = 1.0;
+
+// Every thread's latency histograms, registered on its first timing
+static threadStats* statsThreads[STATS_MAX_THREADS];
+static int statsThreadCount = 0;
+static THREAD_LOCAL threadStats* statsOwn = NULL;
+
+// Names of the operations in stats reports, in enum statOp order
+static const char* const statNames[STAT_OPS] = {
+    "add", "merge", "isbn", "title", "author", "contains",
+    "fuzzy", "words", "checkedout", "checkout", "return"
+};
+
+// Cosmetic pause after an interactive search, in milliseconds; 0 turns it
+// off. Set with --search-delay; batch mode never pauses.
+static int searchDelayMs = 0;
+
+// Console capabilities, filled in at startup
+static terminalInfo terminal = {false, false};
 
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     @FUNCTION PROTOTYPES
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
 int search ();
-void store (book* books, int* bookCount);
-void displayAll (book* books, int bookCount);
-void displaySingle (book* books, int index);
-void returnBook (book* books, int index);
-void checkOutBook (book* books, int index);
-int searchByTitle (book* books, int bookCount);
-int searchByAuthor (book* books, int bookCount);
-int searchByISBN (book* books, int bookCount);
+void store (catalog* cat, isbnIndex* isbnIdx, sortedIndex* titleIdx, sortedIndex* authorIdx, wordIndex* words);
+void displayAll (const catalog* cat);
+void browseCatalog (const catalog* cat, const sortedIndex* titleIdx, const sortedIndex* authorIdx);
+void displaySingle (const catalog* cat, int index);
+void returnBook (catalog* cat, walLog* wal, int index);
+void checkOutBook (catalog* cat, walLog* wal, int index);
+int searchByTitle (const catalog* cat, const sortedIndex* titleIdx, trigramIndex* titleGrams);
+int searchByAuthor (const catalog* cat, const sortedIndex* authorIdx, trigramIndex* authorGrams);
+int searchByISBN (isbnIndex* isbnIdx);
+int searchContaining (const catalog* cat, bool byAuthor);
+int searchWords (const catalog* cat, wordIndex* words);
 char* getAvailability(enum bookStatus status);
-void generateISBN(book* books, int index);
+uint64_t generateISBN(catalog* cat, const isbnIndex* isbnIdx, int index);
 void clearScreen();
 void displayHeader();
 void displayMainMenu();
 void waitForKeypress();
+double nowSeconds(void);
+void pauseMs(int ms);
+double searchStarted(void);
+void searchFinished(enum statOp op, double started);
+void statsInit(void);
+uint64_t statsClock(void);
+void statsRecord(enum statOp op, uint64_t started);
+void statsRecordNanos(enum statOp op, uint64_t nanos);
+void statsCollect(latencyHistogram* totals);
+uint64_t statsPercentile(const latencyHistogram* hist, double quantile);
+memoryUsage measureMemory(const catalog* cat, const isbnIndex* isbnIdx, const trigramIndex* titleGrams,
+                          const trigramIndex* authorGrams, const wordIndex* words);
+void displayStats(const memoryUsage* memory);
+bool fileIsTerminal(FILE* file);
+const char* terminalColor(FILE* file, const char* color);
+void terminalInit(void);
+bool runBatch(batchSession* session, const char* path);
+bool runServer(batchSession* session, const char* address);
+bool runBench(const benchConfig* config);
+bool catalogChangeStatus(catalog* cat, walLog* wal, int index, enum bookStatus from, enum bookStatus to);
+void outputInit(outputBuffer* out);
+void outputFlush(outputBuffer* out);
+void outputFree(outputBuffer* out);
+bool importCatalog(catalog* cat, isbnIndex* isbnIdx, sortedIndex* titleIdx, sortedIndex* authorIdx, const char* path);
+void catalogInit(catalog* cat, int capacity);
+bool catalogOpen(catalog* cat, const char* path);
+void catalogReserve(catalog* cat, int capacity);
+void catalogBeginIndexUpdate(catalog* cat);
+void catalogCommit(catalog* cat);
+void catalogSyncAppends(catalog* cat);
+void catalogFree(catalog* cat);
+void catalogLoadIndexes(catalog* cat, isbnIndex* isbnIdx, sortedIndex* titleIdx, sortedIndex* authorIdx);
+bool mapFileOpen(mappedFile* mf, const char* path);
+bool mapFileResize(mappedFile* mf, size_t size);
+void mapFileFlush(mappedFile* mf);
+void mapFileClose(mappedFile* mf);
+int catalogAppend(catalog* cat, const char* title, const char* author);
+enum bookStatus catalogGetStatus(const catalog* cat, int index);
+void catalogSetStatus(catalog* cat, int index, enum bookStatus status);
+bool catalogTransitionStatus(catalog* cat, int index, enum bookStatus from, enum bookStatus to);
+int catalogCountCheckedOut(const catalog* cat);
+bool walOpen(walLog* wal, const char* catalogPath);
+int walReplay(walLog* wal, catalog* cat, const isbnIndex* isbnIdx, int* unknown);
+void walAppend(walLog* wal, catalog* cat, int index, enum bookStatus oldStatus, enum bookStatus newStatus);
+bool walCommit(walLog* wal, catalog* cat);
+void walCheckpoint(walLog* wal, catalog* cat);
+void walClose(walLog* wal, catalog* cat);
+void isbnIndexInit(isbnIndex* idx);
+void isbnIndexFree(isbnIndex* idx);
+void isbnIndexReserve(isbnIndex* idx, size_t count);
+bool isbnIndexInsert(isbnIndex* idx, uint64_t key, int index);
+int isbnIndexFind(const isbnIndex* idx, uint64_t key);
+bool parseISBN(const char* text, uint64_t* isbn);
+uint64_t isbnScramble(uint64_t sequence);
+isbnRange isbnAllocateRange(catalog* cat, uint64_t count);
+bool isbnRangeNext(isbnRange* range, uint64_t* key);
+uint64_t isbnRangeGenerate(catalog* cat, isbnRange* range, const isbnIndex* isbnIdx);
+void isbnReleaseRange(catalog* cat, const isbnRange* range);
+void formatISBN(uint64_t isbn, char* out);
+void foldKey(foldedKey* key, const char* text);
+void sortedIndexInit(sortedIndex* idx, int* const* order, foldedKey* const* keys);
+void sortedIndexInsertBatch(sortedIndex* idx, int first, int count);
+indexRange sortedIndexExact(const sortedIndex* idx, const foldedKey* key);
+indexRange sortedIndexPrefix(const sortedIndex* idx, const foldedKey* prefix);
+indexRange sortedIndexBetween(const sortedIndex* idx, const foldedKey* low, const foldedKey* high);
+void cursorOpen(catalogCursor* cur, const sortedIndex* idx, indexRange range);
+bool cursorSeek(catalogCursor* cur, size_t offset);
+size_t cursorCount(const catalogCursor* cur);
+int cursorNext(catalogCursor* cur);
+void initContainsKernel(void);
+uint32_t matchScore(const foldedKey* key, const foldedKey* query);
+void resultInit(searchResult* res, size_t limit);
+void resultOffer(searchResult* res, int position, uint32_t score);
+void resultFinish(searchResult* res);
+void resultFree(searchResult* res);
+void resultMerge(searchResult* into, const searchResult* parts, int count);
+void searchKeys(const foldedKey* keys, int count, const foldedKey* query, searchResult* res);
+void searchCheckedOut(const catalog* cat, const foldedKey* keys, const foldedKey* query, searchResult* res);
+void scanPoolInit(int threads);
+void parallelScan(int count, scanChunkFn fn, const void* arg, size_t limit, searchResult* res);
+void searchRange(const sortedIndex* idx, indexRange range, const foldedKey* query, searchResult* res);
+void trigramIndexInit(trigramIndex* idx);
+void trigramIndexSync(trigramIndex* idx, const foldedKey* keys, int count);
+void trigramIndexFree(trigramIndex* idx);
+void fuzzySearch(trigramIndex* idx, const foldedKey* keys, int count, const foldedKey* query, searchResult* res);
+void wordIndexInit(wordIndex* idx);
+void wordIndexSync(wordIndex* idx, const foldedKey* keys, int count);
+void wordIndexFree(wordIndex* idx);
+void wordSearch(wordIndex* idx, const foldedKey* keys, int count, const char* query, searchResult* res);
 // void typewriter(const char *text, int delay_ms);
 
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     @MAIN FUNCTION
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
-int main ()
+int main (int argc, char* argv[])
 {
-    // Declare array that will hold books
-    struct Book books[100];
+    // Declare the catalog that will hold books
+    catalog cat;
+    isbnIndex isbnIdx;
+    sortedIndex titleIdx;
+    sortedIndex authorIdx;
+    trigramIndex titleGrams;
+    trigramIndex authorGrams;
+    wordIndex titleWords;
+    walLog wal;
+
+    // Usage: library [catalog-file] [--import books.csv | --batch commands.txt] [--search-delay MS] [--threads N]
+    //        library --bench BOOKS [--zipf S] [--seed N]
+    const char* catalogPath = CATALOG_DEFAULT_PATH;
+    const char* importPath = NULL;
+    const char* batchPath = NULL;  // "-" reads commands from stdin
+    const char* serveAddress = NULL;  // TCP port on 127.0.0.1, or a Unix socket path
+    int scanThreads = 0;  // Threads for unindexed scans; 0 is one per processor
+    benchConfig bench = {0, BENCH_DEFAULT_ZIPF, 1};  // --bench runs instead of everything else
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--import") == 0 && i + 1 < argc) {
+            importPath = argv[++i];
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batchPath = argv[++i];
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serveAddress = argv[++i];
+        } else if (strcmp(argv[i], "--search-delay") == 0 && i + 1 < argc) {
+            searchDelayMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            scanThreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            bench.books = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--zipf") == 0 && i + 1 < argc) {
+            bench.zipf = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            bench.seed = strtoull(argv[++i], NULL, 10);
+        } else {
+            catalogPath = argv[i];
+        }
+    }
+    bool interactive = (importPath == NULL && batchPath == NULL && serveAddress == NULL);
+    terminalInit();
+    if (bench.books > 0) return runBench(&bench) ? 0 : 1;
+
+    if (!catalogOpen(&cat, catalogPath)) {
+        if (importPath != NULL) return 1;  // Nowhere to import into
+        FILE* notice = interactive ? stdout : stderr;
+        fprintf(notice, "%sBooks added in this session will not be saved.\n%s",
+                terminalColor(notice, YELLOW), terminalColor(notice, RESET));
+        if (interactive) waitForKeypress();
+        catalogInit(&cat, CATALOG_INITIAL_CAPACITY);
+    }
+
+    initContainsKernel();
+    scanPoolInit(scanThreads);
+    statsInit();
+    isbnIndexInit(&isbnIdx);
+    sortedIndexInit(&titleIdx, &cat.titleOrder, &cat.titleKeys);
+    sortedIndexInit(&authorIdx, &cat.authorOrder, &cat.authorKeys);
+    catalogLoadIndexes(&cat, &isbnIdx, &titleIdx, &authorIdx);
+    trigramIndexInit(&titleGrams);
+    trigramIndexInit(&authorGrams);
+    wordIndexInit(&titleWords);
+
+    // Re-apply check-outs and returns logged since the last checkpoint
+    memset(&wal, 0, sizeof(wal));
+    if (cat.persistent && walOpen(&wal, catalogPath)) {
+        int unknown;
+        int replayed = walReplay(&wal, &cat, &isbnIdx, &unknown);
+        FILE* notice = interactive ? stdout : stderr;
+        if (replayed > 0) {
+            fprintf(notice, "%sRecovered %d check-outs/returns from %s.\n%s",
+                    terminalColor(notice, GREEN), replayed, wal.path, terminalColor(notice, RESET));
+        }
+        if (unknown > 0) {
+            fprintf(notice, "%sSkipped %d logged check-outs/returns of books not in %s.\n%s",
+                    terminalColor(notice, RED), unknown, catalogPath, terminalColor(notice, RESET));
+        }
+        if (interactive && (replayed > 0 || unknown > 0)) waitForKeypress();
+    }
 
-    int bookCount = 0;
+    // Bulk import runs without the menu
+    if (importPath != NULL) {
+        bool imported = importCatalog(&cat, &isbnIdx, &titleIdx, &authorIdx, importPath);
+        walClose(&wal, &cat);
+        isbnIndexFree(&isbnIdx);
+        trigramIndexFree(&titleGrams);
+        trigramIndexFree(&authorGrams);
+        wordIndexFree(&titleWords);
+        catalogFree(&cat);
+        return imported ? 0 : 1;
+    }
+
+    // Command and server modes run scripted operations instead of the menu
+    if (batchPath != NULL || serveAddress != NULL) {
+        batchSession session = {&cat, &wal, &isbnIdx, &titleIdx, &authorIdx, &titleGrams, &authorGrams, &titleWords};
+        bool ran = (serveAddress != NULL) ? runServer(&session, serveAddress) : runBatch(&session, batchPath);
+        walClose(&wal, &cat);
+        isbnIndexFree(&isbnIdx);
+        trigramIndexFree(&titleGrams);
+        trigramIndexFree(&authorGrams);
+        wordIndexFree(&titleWords);
+        catalogFree(&cat);
+        return ran ? 0 : 1;
+    }
+    // Index the catalog for typo-tolerant searches before the first one
+    trigramIndexSync(&titleGrams, cat.titleKeys, cat.count);
+    trigramIndexSync(&authorGrams, cat.authorKeys, cat.count);
+    wordIndexSync(&titleWords, cat.titleKeys, cat.count);
     int usrChoice;
 
     // Main menu loop
@@ -78,30 +763,30 @@ int main ()
             case '1':
                clearScreen();
                displayHeader();
-               store(books, &bookCount);
+               store(&cat, &isbnIdx, &titleIdx, &authorIdx, &titleWords);
                waitForKeypress();
                break;
             case '2':
                 clearScreen();
                 displayHeader();
-                if (bookCount > 0) {
-                    displayAll(books, bookCount);
+                if (cat.count > 0) {
+                    browseCatalog(&cat, &titleIdx, &authorIdx);
                 } else {
                     printf(RED"\nNo books to display.\n"RESET);
+                    waitForKeypress();
                 }
-                waitForKeypress();
                 break;
             case '3':
                 clearScreen();
                 displayHeader();
-                if (bookCount <= 0) {
+                if (cat.count <= 0) {
                     printf(RED"\nNo books to search.\n"RESET);
                     waitForKeypress();
                     break;
                 }
                 
                 printf(CYAN"<=======================================>\n<< Enter mode to search >>\n<=======================================>\n"RESET);
-                printf(YELLOW"~~ 1 - By Title\t2 - By Author\n~~ 3 - By ISBN\n<=======================================>\n|=> "RESET);
+                printf(YELLOW"~~ 1 - By Title\t2 - By Author\n~~ 3 - By ISBN\n~~ 4 - Title Contains\t5 - Author Contains\n~~ 6 - Title Words\n<=======================================>\n|=> "RESET);
 
                 int searchType;
                 int index = -1;  // Initialize to invalid index
@@ -113,20 +798,33 @@ int main ()
                     case '1':
                         clearScreen();
                         displayHeader();
-                        index = searchByTitle(books, bookCount);
-                        if (index > -1) displaySingle(books, index);
+                        index = searchByTitle(&cat, &titleIdx, &titleGrams);
+                        if (index > -1) displaySingle(&cat, index);
                         break;
                     case '2':
                         clearScreen();
                         displayHeader();
-                        index = searchByAuthor(books, bookCount);
-                        if (index > -1) displaySingle(books, index);
+                        index = searchByAuthor(&cat, &authorIdx, &authorGrams);
+                        if (index > -1) displaySingle(&cat, index);
                         break;
                     case '3': 
                         clearScreen();
                         displayHeader();
-                        index = searchByISBN(books, bookCount);
-                        if (index > -1) displaySingle(books, index);
+                        index = searchByISBN(&isbnIdx);
+                        if (index > -1) displaySingle(&cat, index);
+                        break;
+                    case '4':
+                    case '5':
+                        clearScreen();
+                        displayHeader();
+                        index = searchContaining(&cat, searchType == '5');
+                        if (index > -1) displaySingle(&cat, index);
+                        break;
+                    case '6':
+                        clearScreen();
+                        displayHeader();
+                        index = searchWords(&cat, &titleWords);
+                        if (index > -1) displaySingle(&cat, index);
                         break;
                     default:
                         printf(RED"Invalid choice. Please try again.\n"RESET);
@@ -145,10 +843,10 @@ int main ()
                     switch(option)
                     {
                         case 1:
-                            returnBook(books, index);
+                            returnBook(&cat, &wal, index);
                             break;
                         case 2:
-                            checkOutBook(books, index);
+                            checkOutBook(&cat, &wal, index);
                             break;
                         case 3:
                             break;
@@ -156,12 +854,28 @@ int main ()
                             printf(RED"Invalid option. Going back to main menu.\n"RESET);
                             break;
                     }
+                    walCommit(&wal, &cat);  // One fsync per desk action
                     waitForKeypress();
                 }
                 break;
             case '4':
+                clearScreen();
+                displayHeader();
+                {
+                    memoryUsage memory = measureMemory(&cat, &isbnIdx, &titleGrams, &authorGrams, &titleWords);
+                    displayStats(&memory);
+                }
+                waitForKeypress();
+                break;
+            case '5':
                 clearScreen();
                 printf(GREEN"\nThank you for using the Library Management System!\n\n"RESET);
+                walClose(&wal, &cat);  // Checkpoints, leaving an empty log
+                isbnIndexFree(&isbnIdx);
+                trigramIndexFree(&titleGrams);
+                trigramIndexFree(&authorGrams);
+                wordIndexFree(&titleWords);
+                catalogFree(&cat);  // Flushes a file-backed catalog
                 exit(0);
                 break;
             default:
@@ -172,9 +886,51 @@ int main ()
     }
 }
 
-// Function to clear the console screen (Windows-specific)
+// Work out once whether stdout is a console and whether it takes ANSI
+// escape sequences. Windows 10+ consoles only do after opting in.
+void terminalInit(void)
+{
+    terminal.isTerminal = fileIsTerminal(stdout);
+    terminal.ansi = false;
+    if (!terminal.isTerminal) return;
+#ifdef _WIN32
+    HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD mode = 0;
+    if (GetConsoleMode(console, &mode)) {
+        terminal.ansi = SetConsoleMode(console, mode | 0x0004) != 0;  // ENABLE_VIRTUAL_TERMINAL_PROCESSING
+    }
+#else
+    const char* term = getenv("TERM");
+    terminal.ansi = (term != NULL && strcmp(term, "dumb") != 0);
+#endif
+}
+
+// Clear the console and home the cursor. The escape sequence goes through
+// stdout's buffer, so it reaches the console in the same write as the
+// first line of the redrawn screen. Files and pipes are left untouched.
 void clearScreen() {
-    system("cls");
+    if (terminal.ansi) {
+        fputs("\x1b[H\x1b[2J\x1b[3J", stdout);
+        return;
+    }
+#ifdef _WIN32
+    // Consoles without ANSI support: blank the buffer through the console API
+    if (terminal.isTerminal) {
+        HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+        CONSOLE_SCREEN_BUFFER_INFO info;
+        COORD home = {0, 0};
+        DWORD written;
+        fflush(stdout);
+        if (GetConsoleScreenBufferInfo(console, &info)) {
+            DWORD cells = (DWORD)info.dwSize.X * (DWORD)info.dwSize.Y;
+            FillConsoleOutputCharacterA(console, ' ', cells, home, &written);
+            FillConsoleOutputAttribute(console, info.wAttributes, cells, home, &written);
+            SetConsoleCursorPosition(console, home);
+        }
+    }
+#else
+    if (terminal.isTerminal) putchar('\n');  // Dumb terminal: just separate the screens
+#endif
 }
 
 // Display the header/banner of the program
@@ -192,7 +948,8 @@ void displayMainMenu() {
            "|| 1 - Add Books                       ||\n"
            "|| 2 - Display All Books               ||\n"
            "|| 3 - Search Books                    ||\n"
-           "|| 4 - Exit                           ||\n"
+           "|| 4 - Statistics                      ||\n"
+           "|| 5 - Exit                            ||\n"
            "<=======================================>\n"
            "|>> "RESET);
 }
@@ -203,262 +960,4354 @@ void waitForKeypress() {
     getchar();
 }
 
-// Generate a unique isbn per book added
-void generateISBN(book* books, int index)
+// Monotonic wall-clock time in seconds, for timing long operations
+double nowSeconds(void)
 {
-    srand(time(NULL) + index); // Better seeding based on time and index
-    
-    // Initialize isbn string
-    memset(books[index].isbn, 0, sizeof(books[index].isbn));
-    
-    // Generate ISBN format: XXXX-XXXX-XXXX-XXXX (all digits)
-    int j = 0;
-    for (int i = 0; i < 19; i++) {
-        if (i == 4 || i == 9 || i == 14) {
-            books[index].isbn[i] = '-';
-        } else {
-            books[index].isbn[i] = '0' + (rand() % 10);  // Generate digits 0-9
-        }
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+// Sleep for a number of milliseconds
+void pauseMs(int ms)
+{
+#ifdef _WIN32
+    Sleep((DWORD)ms);
+#else
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    nanosleep(&ts, NULL);
+#endif
+}
+
+// Start of a desk search: show the "Searching..." cue and start the clock
+double searchStarted(void)
+{
+    printf(YELLOW"\nSearching..."RESET);
+    fflush(stdout);
+    return nowSeconds();
+}
+
+// End of a desk search: record and report how long the lookup took. A
+// cosmetic delay (--search-delay) only pads whatever is left of it once the
+// search is done.
+void searchFinished(enum statOp op, double started)
+{
+    double elapsed = nowSeconds() - started;
+    statsRecordNanos(op, (uint64_t)(elapsed * 1e9));
+    printf(CYAN" (%.3f ms)"RESET, elapsed * 1000.0);
+
+    double remaining = searchDelayMs / 1000.0 - elapsed;
+    if (remaining > 0) {
+        fflush(stdout);
+        pauseMs((int)(remaining * 1000.0));
     }
-    books[index].isbn[19] = '\0'; // Ensure null termination
+}
+
+// Give a book the next ISBN from the catalog's sequence, skipping any
+// that are already taken (e.g. imported ones). Returns the ISBN.
+uint64_t generateISBN(catalog* cat, const isbnIndex* isbnIdx, int index)
+{
+    uint64_t isbn;
+
+    do {
+        isbn = isbnScramble(cat->isbnSequence++);
+    } while (isbnIndexFind(isbnIdx, isbn) >= 0);
+
+    cat->isbns[index] = isbn;
+    return isbn;
 }
 
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-    @SEARCH FUNCTIONS
+    @FILE MAPPING FUNCTIONS
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
-// Search book by book title
-int searchByTitle(book* books, int bookCount)
+#ifdef _WIN32
+
+static void unmapView(mappedFile* mf)
 {
-    int index = -1;
-    char titleToSearch[50];  // Match size with book structure
+    if (mf->base != NULL) {
+        UnmapViewOfFile(mf->base);
+        CloseHandle(mf->mapping);
+    }
+    mf->base = NULL;
+    mf->mapping = NULL;
+    mf->size = 0;
+}
 
-    printf(CYAN"\n<=======================================>\n"
-           "||             SEARCH BY TITLE            ||\n"
-           "<=======================================>\n"RESET);
-    printf(CYAN"Enter book title: "RESET);
-    scanf(" %49[^\n]", titleToSearch);  // Prevent buffer overflow
-    while (getchar() != '\n');  // Clear input buffer
+// Open or create a file for read/write and map all of it, if it has any size
+bool mapFileOpen(mappedFile* mf, const char* path)
+{
+    LARGE_INTEGER size;
 
-    printf(YELLOW"\nSearching..."RESET);
-    Sleep(500); // Add a small delay for better UX
+    mf->base = NULL;
+    mf->mapping = NULL;
+    mf->size = 0;
+    mf->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                           OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (mf->file == INVALID_HANDLE_VALUE) return false;
 
-    for (int i = 0; i < bookCount; i++)
-    {
-        char bookTitle[50];
-        char searchTitle[50];
-        
-        // Create temporary copies for the strlwr function
-        strcpy(bookTitle, books[i].title);
-        strcpy(searchTitle, titleToSearch);
-        
-        if (strcmp(strlwr(bookTitle), strlwr(searchTitle)) == 0)
-        {
-            printf(GREEN"\nBook is found!\n"RESET);
-            index = i;
-            return index;
-        }
+    if (!GetFileSizeEx(mf->file, &size)) {
+        CloseHandle(mf->file);
+        return false;
     }
-
-    printf(RED"\nBook is not found.\n"RESET);
-    return -1;
+    if (size.QuadPart > 0 && !mapFileResize(mf, (size_t)size.QuadPart)) {
+        CloseHandle(mf->file);
+        return false;
+    }
+    return true;
 }
 
-// Search book by author
-int searchByAuthor(book* books, int bookCount)
+// Set the file to exactly `size` bytes and map it again
+bool mapFileResize(mappedFile* mf, size_t size)
 {
-    int index = -1;
-    char authorToSearch[50];  // Match size with book structure
+    LARGE_INTEGER end;
 
-    printf(CYAN"\n<=======================================>\n"
-           "||             SEARCH BY AUTHOR           ||\n"
-           "<=======================================>\n"RESET);
-    printf(CYAN"Enter author name: "RESET);
-    scanf(" %49[^\n]", authorToSearch);  // Prevent buffer overflow
-    while (getchar() != '\n');  // Clear input buffer
+    unmapView(mf);
+    end.QuadPart = (LONGLONG)size;
+    if (!SetFilePointerEx(mf->file, end, NULL, FILE_BEGIN) || !SetEndOfFile(mf->file)) return false;
 
-    printf(YELLOW"\nSearching..."RESET);
-    Sleep(500); // Add a small delay for better UX
+    mf->mapping = CreateFileMappingA(mf->file, NULL, PAGE_READWRITE, 0, 0, NULL);
+    if (mf->mapping == NULL) return false;
 
-    for (int i = 0; i < bookCount; i++)
-    {
-        char bookAuthor[50];
-        char searchAuthor[50];
-        
-        // Create temporary copies for the strlwr function
-        strcpy(bookAuthor, books[i].author);
-        strcpy(searchAuthor, authorToSearch);
-        
-        if (strcmp(strlwr(bookAuthor), strlwr(searchAuthor)) == 0)
-        {
-            printf(GREEN"\nBook is found!\n"RESET);
-            index = i;
-            return index;
-        }
+    mf->base = (char*)MapViewOfFile(mf->mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (mf->base == NULL) {
+        CloseHandle(mf->mapping);
+        mf->mapping = NULL;
+        return false;
     }
+    mf->size = size;
+    return true;
+}
 
-    printf(RED"\nBook is not found.\n"RESET);
-    return -1;
+// Write dirty pages of the mapping back to the file
+void mapFileFlush(mappedFile* mf)
+{
+    if (mf->base != NULL) {
+        FlushViewOfFile(mf->base, 0);
+        FlushFileBuffers(mf->file);
+    }
 }
 
-// Search book by book isbn
-int searchByISBN(book* books, int bookCount)
+void mapFileClose(mappedFile* mf)
 {
-    int index = -1;
-    char isbnToSearch[20];  // Match size with book structure
+    mapFileFlush(mf);
+    unmapView(mf);
+    CloseHandle(mf->file);
+    mf->file = INVALID_HANDLE_VALUE;
+}
 
-    printf(CYAN"\n<=======================================>\n"
-           "||              SEARCH BY ISBN             ||\n"
-           "<=======================================>\n"RESET);
-    printf(CYAN"Enter ISBN: "RESET);
-    scanf(" %19[^\n]", isbnToSearch);  // Prevent buffer overflow
-    while (getchar() != '\n');  // Clear input buffer
+#else
 
-    printf(YELLOW"\nSearching..."RESET);
-    Sleep(500); // Add a small delay for better UX
+// Open or create a file for read/write and map all of it, if it has any size
+bool mapFileOpen(mappedFile* mf, const char* path)
+{
+    struct stat st;
 
-    for (int i = 0; i < bookCount; i++)
-    {
-        char bookISBN[20];
-        char searchISBN[20];
-        
-        // Create temporary copies for the strlwr function
-        strcpy(bookISBN, books[i].isbn);
-        strcpy(searchISBN, isbnToSearch);
-        
-        if (strcmp(strlwr(bookISBN), strlwr(searchISBN)) == 0)
-        {
-            printf(GREEN"\nBook is found!\n"RESET);
-            index = i;
-            return index;
-        }
+    mf->base = NULL;
+    mf->size = 0;
+    mf->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (mf->fd < 0) return false;
+
+    if (fstat(mf->fd, &st) != 0
+        || (st.st_size > 0 && !mapFileResize(mf, (size_t)st.st_size))) {
+        close(mf->fd);
+        mf->fd = -1;
+        return false;
     }
+    return true;
+}
 
-    printf(RED"\nBook is not found.\n"RESET);
-    return -1;
+// Set the file to exactly `size` bytes and map it again
+bool mapFileResize(mappedFile* mf, size_t size)
+{
+    if (mf->base != NULL) {
+        munmap(mf->base, mf->size);
+        mf->base = NULL;
+        mf->size = 0;
+    }
+    if (ftruncate(mf->fd, (off_t)size) != 0) return false;
+
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, mf->fd, 0);
+    if (base == MAP_FAILED) return false;
+
+    mf->base = (char*)base;
+    mf->size = size;
+    return true;
+}
+
+// Write dirty pages of the mapping back to the file
+void mapFileFlush(mappedFile* mf)
+{
+    if (mf->base != NULL) msync(mf->base, mf->size, MS_SYNC);
+}
+
+void mapFileClose(mappedFile* mf)
+{
+    mapFileFlush(mf);
+    if (mf->base != NULL) munmap(mf->base, mf->size);
+    if (mf->fd >= 0) close(mf->fd);
+    mf->base = NULL;
+    mf->size = 0;
+    mf->fd = -1;
 }
 
+#endif
+
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-    @STORE FUNCTION
+    @CATALOG FUNCTIONS
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
-void store(book* books, int* bookCount) {
-    int count = 0;
-    printf(CYAN"\n<=======================================>\n"
-           "||               ADD BOOKS                ||\n"
-           "<=======================================>\n"RESET);
-    printf(CYAN"Enter the number of books to add: "RESET);
-    scanf("%d", &count);
-    while (getchar() != '\n');  // Clear input buffer
-    
-    if (count <= 0) {
-        printf(RED"\nInvalid number of books.\n"RESET);
-        return;
+static void* allocOrExit(size_t size)
+{
+    void* block = malloc(size);
+    if (block == NULL) {
+        printf(RED"Memory allocation failed\n"RESET);
+        exit(1);
     }
-    
-    if (*bookCount + count > 100) {
-        printf(RED"\nNot enough space. Maximum capacity is 100 books.\n"RESET);
-        return;
+    return block;
+}
+
+static void* reallocOrExit(void* block, size_t size)
+{
+    void* grown = realloc(block, size);
+    if (grown == NULL) {
+        printf(RED"Memory allocation failed\n"RESET);
+        exit(1);
     }
+    return grown;
+}
 
-    int startCount = *bookCount;
-    
-    for (int i = startCount; i < (startCount + count); i++)
-    {
-        clearScreen();
-        displayHeader();
-        printf(CYAN"\n<=======================================>\n"
-               "||               ADD BOOKS                ||\n"
-               "<=======================================>\n"RESET);
-        printf(YELLOW"\nBook #%d of %d:\n"RESET, (i - startCount) + 1, count);
-        
-        printf(YELLOW"Book Title: "RESET);
-        scanf(" %49[^\n]", books[i].title);  // Prevent buffer overflow
-        while (getchar() != '\n');  // Clear input buffer
-        
-        printf(YELLOW"Author: "RESET);
-        scanf(" %49[^\n]", books[i].author);  // Prevent buffer overflow
-        while (getchar() != '\n');  // Clear input buffer
+// Number of 64-bit words needed for a status bitmap of `count` books
+static size_t bitmapWords(int count)
+{
+    return ((size_t)count + 63) / 64;
+}
+
+// Bytes one column needs for `capacity` books
+static size_t columnBytes(int column, int capacity)
+{
+    size_t n = (size_t)capacity;
 
-        generateISBN(books, i);
-        books[i].status = AVAILABLE;
+    switch (column) {
+        case COLUMN_TITLES:       return n * 50;
+        case COLUMN_AUTHORS:      return n * 50;
+        case COLUMN_ISBNS:        return n * sizeof(uint64_t);
+        case COLUMN_TITLE_KEYS:   return n * sizeof(foldedKey) + KEY_SIMD_PADDING;
+        case COLUMN_AUTHOR_KEYS:  return n * sizeof(foldedKey) + KEY_SIMD_PADDING;
+        case COLUMN_TITLE_ORDER:  return n * sizeof(int);
+        case COLUMN_AUTHOR_ORDER: return n * sizeof(int);
+        case COLUMN_AVAILABLE:    return bitmapWords(capacity) * sizeof(uint64_t);
+        default:                  return 0;
     }
-    
-    *bookCount += count;
-    printf(GREEN"\nSuccessfully added %d books. Total books: %d\n"RESET, count, *bookCount);
 }
 
-/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-    @DISPLAY FUNCTIONS
-~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void* getColumn(const catalog* cat, int column)
+{
+    switch (column) {
+        case COLUMN_TITLES:       return cat->titles;
+        case COLUMN_AUTHORS:      return cat->authors;
+        case COLUMN_ISBNS:        return cat->isbns;
+        case COLUMN_TITLE_KEYS:   return cat->titleKeys;
+        case COLUMN_AUTHOR_KEYS:  return cat->authorKeys;
+        case COLUMN_TITLE_ORDER:  return cat->titleOrder;
+        case COLUMN_AUTHOR_ORDER: return cat->authorOrder;
+        case COLUMN_AVAILABLE:    return cat->available;
+        default:                  return NULL;
+    }
+}
 
-void displayAll(book* books, int bookCount) {
-    printf(CYAN"\n<=======================================>\n"
-           "||              ALL BOOKS                 ||\n"
-           "<=======================================>\n\n"RESET);
-    
-    for (int i = 0; i < bookCount; i++) {
-        printf(YELLOW"<=======================================>\n"RESET);
-        printf(CYAN"~~> Book #%d\n"RESET, i+1);
-        printf(CYAN"~~> Title: "RESET);
-        printf(GREEN"%s\n"RESET, books[i].title);
-        printf(CYAN"~~> Author:  "RESET);
-        printf(GREEN"%s\n"RESET, books[i].author);
-        printf(CYAN"~~> ISBN: "RESET);
-        printf(GREEN"%s\n"RESET, books[i].isbn);
-        printf(CYAN"~~> AVAILABILITY: "RESET);
-        printf("%s\n", books[i].status == AVAILABLE ? GREEN"Available"RESET : RED"Checked Out"RESET);
+static void setColumn(catalog* cat, int column, void* data)
+{
+    switch (column) {
+        case COLUMN_TITLES:       cat->titles = data; break;
+        case COLUMN_AUTHORS:      cat->authors = data; break;
+        case COLUMN_ISBNS:        cat->isbns = data; break;
+        case COLUMN_TITLE_KEYS:   cat->titleKeys = data; break;
+        case COLUMN_AUTHOR_KEYS:  cat->authorKeys = data; break;
+        case COLUMN_TITLE_ORDER:  cat->titleOrder = data; break;
+        case COLUMN_AUTHOR_ORDER: cat->authorOrder = data; break;
+        case COLUMN_AVAILABLE:    cat->available = data; break;
     }
 }
 
-void displaySingle(book* books, int index) {
-    printf(YELLOW"\n<=======================================>\n"
-           "||              BOOK DETAILS              ||\n"
-           "<=======================================>\n\n"RESET);
-    
-    printf(CYAN"~~> Title: "RESET);
-    printf(GREEN"%s\n"RESET, books[index].title);
-    printf(CYAN"~~> Author: "RESET);
-    printf(GREEN"%s\n"RESET, books[index].author);
-    printf(CYAN"~~> ISBN: "RESET);
-    printf(GREEN"%s\n"RESET, books[index].isbn);
-    printf(CYAN"~~> AVAILABILITY: "RESET);
-    printf("%s\n", books[index].status == AVAILABLE ? GREEN"Available"RESET : RED"Checked Out"RESET);
-    
-    printf(YELLOW"<=======================================>\n"RESET);
+// File offset of every column for a given capacity; returns the file size
+static size_t layoutColumns(int capacity, size_t offsets[COLUMN_COUNT])
+{
+    size_t offset = sizeof(catalogHeader);
+
+    for (int c = 0; c < COLUMN_COUNT; c++) {
+        offsets[c] = offset;
+        offset += columnBytes(c, capacity);
+        offset = (offset + CATALOG_ALIGN - 1) & ~(size_t)(CATALOG_ALIGN - 1);
+    }
+    return offset;
 }
 
-char* getAvailability(enum bookStatus status)
+// Point every column at its place inside the mapped file
+static void attachColumns(catalog* cat)
 {
-    switch(status)
-    {
-        case AVAILABLE:
-            return "Available";
-        case CHECKED_OUT:
-            return "Checked Out";
-        default:
-            return "Unknown";  // Add default case for better error handling
+    size_t offsets[COLUMN_COUNT];
+    layoutColumns(cat->capacity, offsets);
+
+    for (int c = 0; c < COLUMN_COUNT; c++) {
+        setColumn(cat, c, cat->file.base + offsets[c]);
     }
 }
 
-/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static catalogHeader* fileHeader(const catalog* cat)
+{
+    return (catalogHeader*)cat->file.base;
+}
+
+// Start an empty catalog that lives only in memory
+void catalogInit(catalog* cat, int capacity)
+{
+    memset(cat, 0, sizeof(*cat));
+    catalogReserve(cat, capacity);
+}
+
+// Open (or create) a catalog file and use it in place through a memory
+// mapping. Only the header is checked; the columns are used as they are.
+bool catalogOpen(catalog* cat, const char* path)
+{
+    memset(cat, 0, sizeof(*cat));
+
+    if (!mapFileOpen(&cat->file, path)) {
+        printf(RED"\nCould not open catalog file %s.\n"RESET, path);
+        return false;
+    }
+    cat->persistent = true;
+
+    // A new, empty file: lay it out for the initial capacity
+    if (cat->file.size == 0) {
+        catalogReserve(cat, CATALOG_INITIAL_CAPACITY);
+
+        catalogHeader* header = fileHeader(cat);
+        memcpy(header->magic, CATALOG_MAGIC, sizeof(header->magic));
+        header->version = CATALOG_VERSION;
+        header->keySize = sizeof(foldedKey);
+        header->capacity = (uint32_t)cat->capacity;
+        return true;
+    }
+
+    const catalogHeader* header = fileHeader(cat);
+    size_t offsets[COLUMN_COUNT];
+
+    if (cat->file.size < sizeof(catalogHeader)
+        || memcmp(header->magic, CATALOG_MAGIC, sizeof(header->magic)) != 0
+        || header->version != CATALOG_VERSION
+        || header->keySize != sizeof(foldedKey)
+        || header->capacity > INT_MAX
+        || header->count > header->capacity
+        || layoutColumns((int)header->capacity, offsets) > cat->file.size) {
+        printf(RED"\n%s is not a catalog file this version can read.\n"RESET, path);
+        mapFileClose(&cat->file);
+        memset(cat, 0, sizeof(*cat));
+        return false;
+    }
+
+    cat->count = (int)header->count;
+    cat->capacity = (int)header->capacity;
+    cat->indexedCount = (header->indexedCount == header->count) ? cat->count : 0;
+    cat->isbnSequence = header->isbnSequence;
+    attachColumns(cat);
+    return true;
+}
+
+// Grow a file-backed catalog: extend and remap the file, then slide every
+// column up to its offset for the new capacity. Columns are moved last to
+// first so none is overwritten before it has moved.
+static void growMapped(catalog* cat, int newCapacity)
+{
+    size_t oldOffsets[COLUMN_COUNT];
+    size_t newOffsets[COLUMN_COUNT];
+    int oldCapacity = cat->capacity;
+
+    layoutColumns(oldCapacity, oldOffsets);
+    size_t size = layoutColumns(newCapacity, newOffsets);
+
+    if (!mapFileResize(&cat->file, size)) {
+        printf(RED"Could not grow the catalog file\n"RESET);
+        exit(1);
+    }
+
+    // A brand-new file has no columns to move yet
+    if (oldCapacity > 0) {
+        for (int c = COLUMN_COUNT - 1; c >= 0; c--) {
+            memmove(cat->file.base + newOffsets[c], cat->file.base + oldOffsets[c],
+                    columnBytes(c, oldCapacity));
+        }
+    }
+
+    cat->capacity = newCapacity;
+    attachColumns(cat);
+
+    size_t oldWords = bitmapWords(oldCapacity);
+    memset(cat->available + oldWords, 0, (bitmapWords(newCapacity) - oldWords) * sizeof(uint64_t));
+    fileHeader(cat)->capacity = (uint32_t)newCapacity;
+}
+
+// Make room for at least `capacity` books. Columns grow geometrically, so a
+// run of appends costs amortized O(1) each; store reserves a whole batch up
+// front.
+void catalogReserve(catalog* cat, int capacity)
+{
+    if (capacity <= cat->capacity) return;
+
+    int newCapacity = cat->capacity ? cat->capacity : CATALOG_INITIAL_CAPACITY;
+    while (newCapacity < capacity) {
+        newCapacity = (newCapacity > INT_MAX / 2) ? INT_MAX : newCapacity * 2;
+    }
+
+    if (cat->persistent) {
+        growMapped(cat, newCapacity);
+        return;
+    }
+
+    size_t oldWords = bitmapWords(cat->capacity);
+    for (int c = 0; c < COLUMN_COUNT; c++) {
+        setColumn(cat, c, reallocOrExit(getColumn(cat, c), columnBytes(c, newCapacity)));
+    }
+    memset(cat->available + oldWords, 0, (bitmapWords(newCapacity) - oldWords) * sizeof(uint64_t));
+    cat->capacity = newCapacity;
+}
+
+// Mark the persisted order columns as being rewritten. Until the next
+// commit a reopened file rebuilds them instead of trusting a half merge.
+void catalogBeginIndexUpdate(catalog* cat)
+{
+    cat->indexedCount = 0;
+    if (cat->persistent) fileHeader(cat)->indexedCount = 0;
+}
+
+// Publish appended books and the merged order columns to the file header.
+// Books past the committed count are ignored when the file is reopened.
+void catalogCommit(catalog* cat)
+{
+    cat->indexedCount = cat->count;
+    if (!cat->persistent) return;
+
+    catalogHeader* header = fileHeader(cat);
+    header->count = (uint32_t)cat->count;
+    header->indexedCount = (uint32_t)cat->count;
+    header->isbnSequence = cat->isbnSequence;
+}
+
+// Make books appended since the header was last written durable without
+// merging them into the order columns: flush their rows, then publish the
+// count and ISBN sequence and flush the header. The header still records
+// fewer indexed books, so a reopened file rebuilds the orders.
+void catalogSyncAppends(catalog* cat)
+{
+    if (!cat->persistent) return;
+
+    catalogHeader* header = fileHeader(cat);
+    if (header->count == (uint32_t)cat->count) return;
+
+    mapFileFlush(&cat->file);
+    header->count = (uint32_t)cat->count;
+    header->isbnSequence = cat->isbnSequence;
+    mapFileFlush(&cat->file);
+}
+
+void catalogFree(catalog* cat)
+{
+    if (cat->persistent) {
+        mapFileClose(&cat->file);
+    } else {
+        for (int c = 0; c < COLUMN_COUNT; c++) {
+            free(getColumn(cat, c));
+        }
+    }
+    memset(cat, 0, sizeof(*cat));
+}
+
+// Append a book as AVAILABLE and return its position, growing the columns if needed
+int catalogAppend(catalog* cat, const char* title, const char* author)
+{
+    if (cat->count == cat->capacity) {
+        catalogReserve(cat, cat->count + 1);
+    }
+
+    int index = cat->count++;
+
+    snprintf(cat->titles[index], sizeof(cat->titles[index]), "%s", title);
+    snprintf(cat->authors[index], sizeof(cat->authors[index]), "%s", author);
+    foldKey(&cat->titleKeys[index], cat->titles[index]);
+    foldKey(&cat->authorKeys[index], cat->authors[index]);
+    cat->isbns[index] = 0;
+    catalogSetStatus(cat, index, AVAILABLE);
+    return index;
+}
+
+// Words shared between threads (the status bitmap, scan queues) are only
+// read and replaced atomically, so two desks cannot both win the same copy
+// and readers never wait behind a writer
+static uint64_t atomicLoad64(const uint64_t* word)
+{
+#if defined(__GNUC__)
+    return __atomic_load_n(word, __ATOMIC_ACQUIRE);
+#elif defined(_MSC_VER)
+    return (uint64_t)InterlockedCompareExchange64((volatile LONG64*)word, 0, 0);
+#else
+    return *(const volatile uint64_t*)word;
+#endif
+}
+
+// Replace *word with desired if it still holds expected
+static bool atomicSwap64(uint64_t* word, uint64_t expected, uint64_t desired)
+{
+#if defined(__GNUC__)
+    return __atomic_compare_exchange_n(word, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#elif defined(_MSC_VER)
+    return (uint64_t)InterlockedCompareExchange64((volatile LONG64*)word, (LONG64)desired, (LONG64)expected) == expected;
+#else
+    if (*word != expected) return false;
+    *word = desired;
+    return true;
+#endif
+}
+
+enum bookStatus catalogGetStatus(const catalog* cat, int index)
+{
+    return ((atomicLoad64(&cat->available[index / 64]) >> (index % 64)) & 1) ? AVAILABLE : CHECKED_OUT;
+}
+
+// Compare-and-swap the book's status bit from `from` to `to`. Fails only if
+// the book is not in status `from`; a race with a neighbour in the same word
+// just retries.
+bool catalogTransitionStatus(catalog* cat, int index, enum bookStatus from, enum bookStatus to)
+{
+    uint64_t* word = &cat->available[index / 64];
+    uint64_t bit = (uint64_t)1 << (index % 64);
+
+    for (;;) {
+        uint64_t current = atomicLoad64(word);
+        bool isAvailable = (current & bit) != 0;
+        if (isAvailable != (from == AVAILABLE)) return false;
+
+        uint64_t desired = to == AVAILABLE ? (current | bit) : (current & ~bit);
+        if (current == desired || atomicSwap64(word, current, desired)) return true;
+    }
+}
+
+void catalogSetStatus(catalog* cat, int index, enum bookStatus status)
+{
+    enum bookStatus other = status == AVAILABLE ? CHECKED_OUT : AVAILABLE;
+    catalogTransitionStatus(cat, index, other, status);
+}
+
+static int popcount64(uint64_t word)
+{
+#if defined(__GNUC__)
+    return __builtin_popcountll(word);
+#else
+    int bits = 0;
+    while (word != 0) {
+        word &= word - 1;
+        bits++;
+    }
+    return bits;
+#endif
+}
+
+// Index of the lowest set bit; word must not be 0
+static int lowestBit64(uint64_t word)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(word);
+#else
+    int bit = 0;
+    while ((word & 1) == 0) {
+        word >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+// Index of the highest set bit; word must not be 0
+static int highestBit64(uint64_t word)
+{
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(word);
+#else
+    int bit = 63;
+    while ((word >> bit) == 0) bit--;
+    return bit;
+#endif
+}
+
+// Count checked-out books by reading only the status bitmap
+int catalogCountCheckedOut(const catalog* cat)
+{
+    size_t words = bitmapWords(cat->count);
+    int availableCount = 0;
+
+    for (size_t w = 0; w < words; w++) {
+        availableCount += popcount64(atomicLoad64(&cat->available[w]));
+    }
+    return cat->count - availableCount;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @WRITE-AHEAD LOG FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+// Force written log bytes to the disk
+static bool syncFile(FILE* file)
+{
+    if (fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+static bool truncateFile(FILE* file, size_t size)
+{
+    if (fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _chsize_s(_fileno(file), (long long)size) == 0;
+#else
+    return ftruncate(fileno(file), (off_t)size) == 0;
+#endif
+}
+
+static uint32_t walChecksum(const walRecord* record)
+{
+    const uint8_t* bytes = (const uint8_t*)record;
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < offsetof(walRecord, checksum); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Open (or create) the log that belongs to a catalog file
+bool walOpen(walLog* wal, const char* catalogPath)
+{
+    walHeader header;
+    size_t pathLen = strlen(catalogPath) + sizeof(WAL_SUFFIX);
+
+    memset(wal, 0, sizeof(*wal));
+    wal->path = allocOrExit(pathLen);
+    snprintf(wal->path, pathLen, "%s%s", catalogPath, WAL_SUFFIX);
+
+    wal->file = fopen(wal->path, "r+b");
+    if (wal->file == NULL) wal->file = fopen(wal->path, "w+b");
+    if (wal->file == NULL) {
+        printf(RED"\nCould not open log file %s. Check-outs will only be saved on exit.\n"RESET, wal->path);
+        walClose(wal, NULL);
+        return false;
+    }
+
+    // A new log is just a header
+    if (fread(&header, sizeof(header), 1, wal->file) != 1) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, WAL_MAGIC, sizeof(header.magic));
+        header.version = WAL_VERSION;
+        header.recordSize = sizeof(walRecord);
+
+        if (!truncateFile(wal->file, 0) || fseek(wal->file, 0, SEEK_SET) != 0
+            || fwrite(&header, sizeof(header), 1, wal->file) != 1 || !syncFile(wal->file)) {
+            printf(RED"\nCould not write log file %s.\n"RESET, wal->path);
+            walClose(wal, NULL);
+            return false;
+        }
+    } else if (memcmp(header.magic, WAL_MAGIC, sizeof(header.magic)) != 0
+               || header.version != WAL_VERSION
+               || header.recordSize != sizeof(walRecord)) {
+        printf(RED"\n%s is not a log file this version can read.\n"RESET, wal->path);
+        walClose(wal, NULL);
+        return false;
+    }
+
+    fseek(wal->file, 0, SEEK_END);
+    wal->size = (size_t)ftell(wal->file);
+    return true;
+}
+
+// Apply every intact record in the log to the catalog, then checkpoint.
+// Replay stops at the first torn or corrupt record, which can only be the
+// tail of a group that never finished its fsync. Returns the records applied;
+// records for books the catalog does not have are counted in *unknown.
+int walReplay(walLog* wal, catalog* cat, const isbnIndex* isbnIdx, int* unknown)
+{
+    walRecord record;
+    int applied = 0;
+
+    *unknown = 0;
+    if (wal->file == NULL) return 0;
+
+    fseek(wal->file, (long)sizeof(walHeader), SEEK_SET);
+    while (fread(&record, sizeof(record), 1, wal->file) == 1) {
+        if (record.checksum != walChecksum(&record)) break;
+
+        // The logged position is right unless the catalog lost books since
+        int index = -1;
+        if (record.position < (uint32_t)cat->count && cat->isbns[record.position] == record.isbn) {
+            index = (int)record.position;
+        } else {
+            index = isbnIndexFind(isbnIdx, record.isbn);
+        }
+        if (index < 0) {
+            (*unknown)++;
+            continue;
+        }
+
+        catalogSetStatus(cat, index, record.newStatus == AVAILABLE ? AVAILABLE : CHECKED_OUT);
+        applied++;
+    }
+
+    if (wal->size > sizeof(walHeader)) walCheckpoint(wal, cat);
+    return applied;
+}
+
+// Queue a status transition. It is durable once the next walCommit returns.
+void walAppend(walLog* wal, catalog* cat, int index, enum bookStatus oldStatus, enum bookStatus newStatus)
+{
+    if (wal->file == NULL) return;
+    if (wal->pendingCount == WAL_GROUP_RECORDS) walCommit(wal, cat);
+
+    walRecord* record = &wal->pending[wal->pendingCount++];
+    memset(record, 0, sizeof(*record));
+    record->isbn = cat->isbns[index];
+    record->timestamp = (int64_t)time(NULL);
+    record->position = (uint32_t)index;
+    record->oldStatus = (uint8_t)oldStatus;
+    record->newStatus = (uint8_t)newStatus;
+    record->checksum = walChecksum(record);
+}
+
+// Group commit: write every pending record with one write and one fsync,
+// then checkpoint if the log has grown past WAL_CHECKPOINT_BYTES
+bool walCommit(walLog* wal, catalog* cat)
+{
+    if (wal->file == NULL || wal->pendingCount == 0) return true;
+
+    size_t count = (size_t)wal->pendingCount;
+    fseek(wal->file, 0, SEEK_END);
+    if (fwrite(wal->pending, sizeof(walRecord), count, wal->file) != count
+        || !syncFile(wal->file)) {
+        printf(RED"\nCould not write log file %s.\n"RESET, wal->path);
+        return false;
+    }
+
+    wal->pendingCount = 0;
+    wal->size += count * sizeof(walRecord);
+    if (wal->size >= WAL_CHECKPOINT_BYTES) walCheckpoint(wal, cat);
+    return true;
+}
+
+// Flush the catalog mapping so it holds every logged transition, then empty
+// the log. A crash in between only means the same records are replayed again.
+void walCheckpoint(walLog* wal, catalog* cat)
+{
+    if (wal->file == NULL) return;
+    if (wal->pendingCount > 0 && !walCommit(wal, cat)) return;
+
+    mapFileFlush(&cat->file);
+    if (!truncateFile(wal->file, sizeof(walHeader)) || !syncFile(wal->file)) {
+        printf(RED"\nCould not reset log file %s.\n"RESET, wal->path);
+        return;
+    }
+    fseek(wal->file, 0, SEEK_END);
+    wal->size = sizeof(walHeader);
+}
+
+// Checkpoint and close the log; `cat` may be NULL if it was never opened
+void walClose(walLog* wal, catalog* cat)
+{
+    if (wal->file != NULL) {
+        if (cat != NULL) walCheckpoint(wal, cat);
+        fclose(wal->file);
+    }
+    free(wal->path);
+    memset(wal, 0, sizeof(*wal));
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @ISBN INDEX FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+// ISBN-13 check digit for the first twelve digits: weights alternate 1, 3
+// from the left, so the rightmost of the twelve has weight 3
+static int isbnCheckDigit(uint64_t first12)
+{
+    int sum = 0;
+
+    for (int i = 0; i < 12; i++) {
+        int digit = (int)(first12 % 10);
+        sum += (i % 2 == 0) ? digit * 3 : digit;
+        first12 /= 10;
+    }
+    return (10 - sum % 10) % 10;
+}
+
+// Read an ISBN-13 or ISBN-10, bare or with hyphens/spaces, and check its
+// check digit. ISBN-10s are converted to their 978 ISBN-13.
+bool parseISBN(const char* text, uint64_t* isbn)
+{
+    uint64_t value = 0;
+    int digits = 0;
+    int sum10 = 0;      // ISBN-10 weighted sum, weights 10 down to 1
+    bool checkX = false;
+
+    for (size_t i = 0; text[i] != '\0'; i++) {
+        char c = text[i];
+        if (c == '-' || c == ' ') continue;
+        if (checkX || digits == 13) return false;
+
+        if (c >= '0' && c <= '9') {
+            value = value * 10 + (uint64_t)(c - '0');
+            if (digits < 10) sum10 += (10 - digits) * (c - '0');
+            digits++;
+        } else if ((c == 'X' || c == 'x') && digits == 9) {
+            sum10 += 10;  // X stands for 10, only as an ISBN-10 check digit
+            digits++;
+            checkX = true;
+        } else {
+            return false;
+        }
+    }
+
+    if (digits == 10) {
+        if (sum10 % 11 != 0) return false;
+        uint64_t first9 = checkX ? value : value / 10;
+        uint64_t first12 = 978000000000ULL + first9;
+        *isbn = first12 * 10 + (uint64_t)isbnCheckDigit(first12);
+        return true;
+    }
+
+    if (digits != 13) return false;
+    uint64_t prefix = value / 10000000000ULL;
+    if ((prefix != 978 && prefix != 979) || (int)(value % 10) != isbnCheckDigit(value / 10)) {
+        return false;
+    }
+    *isbn = value;
+    return true;
+}
+
+// Mix the key bits so sequential ISBNs spread across the table
+static size_t isbnHash(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return (size_t)key;
+}
+
+static isbnSlot* allocIsbnSlots(size_t capacity)
+{
+    isbnSlot* slots = (isbnSlot*)malloc(capacity * sizeof(isbnSlot));
+    if (slots == NULL) {
+        printf(RED"Memory allocation failed\n"RESET);
+        exit(1);
+    }
+
+    for (size_t i = 0; i < capacity; i++) {
+        slots[i].index = -1;
+    }
+    return slots;
+}
+
+void isbnIndexInit(isbnIndex* idx)
+{
+    idx->capacity = ISBN_INDEX_INITIAL_CAPACITY;
+    idx->count = 0;
+    idx->slots = allocIsbnSlots(idx->capacity);
+}
+
+void isbnIndexFree(isbnIndex* idx)
+{
+    free(idx->slots);
+    idx->slots = NULL;
+    idx->capacity = 0;
+    idx->count = 0;
+}
+
+// Move every occupied slot into a table of newCapacity slots
+static void isbnIndexRehash(isbnIndex* idx, size_t newCapacity)
+{
+    size_t mask = newCapacity - 1;
+    isbnSlot* newSlots = allocIsbnSlots(newCapacity);
+
+    for (size_t i = 0; i < idx->capacity; i++) {
+        if (idx->slots[i].index < 0) continue;
+
+        size_t pos = isbnHash(idx->slots[i].key) & mask;
+        while (newSlots[pos].index >= 0) {
+            pos = (pos + 1) & mask;
+        }
+        newSlots[pos] = idx->slots[i];
+    }
+
+    free(idx->slots);
+    idx->slots = newSlots;
+    idx->capacity = newCapacity;
+}
+
+// Size the table for `count` keys up front so a bulk rebuild never rehashes
+void isbnIndexReserve(isbnIndex* idx, size_t count)
+{
+    size_t capacity = idx->capacity;
+    while (count * 2 > capacity) capacity *= 2;
+    if (capacity != idx->capacity) isbnIndexRehash(idx, capacity);
+}
+
+// Insert a key; returns false if the key is already indexed
+bool isbnIndexInsert(isbnIndex* idx, uint64_t key, int index)
+{
+    // Keep the load factor at or below 1/2 so probe chains stay short
+    if ((idx->count + 1) * 2 > idx->capacity) {
+        isbnIndexRehash(idx, idx->capacity * 2);
+    }
+
+    size_t mask = idx->capacity - 1;
+    size_t pos = isbnHash(key) & mask;
+
+    while (idx->slots[pos].index >= 0) {
+        if (idx->slots[pos].key == key) return false;
+        pos = (pos + 1) & mask;
+    }
+
+    idx->slots[pos].key = key;
+    idx->slots[pos].index = index;
+    idx->count++;
+    return true;
+}
+
+// Find the book index stored under a key, or -1 if absent
+int isbnIndexFind(const isbnIndex* idx, uint64_t key)
+{
+    size_t mask = idx->capacity - 1;
+    size_t pos = isbnHash(key) & mask;
+
+    while (idx->slots[pos].index >= 0) {
+        if (idx->slots[pos].key == key) return idx->slots[pos].index;
+        pos = (pos + 1) & mask;
+    }
+    return -1;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @ISBN ALLOCATOR FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+// "00" to "99", so numbers are formatted two digits per lookup
+static const char digitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static uint32_t scrambleRound(uint32_t half, int round)
+{
+    uint64_t x = ((uint64_t)half << 8 | (uint64_t)round) ^ ISBN_SCRAMBLE_KEY;
+    x ^= x >> 31;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 29;
+    return (uint32_t)x & ((1u << ISBN_SCRAMBLE_HALF_BITS) - 1);
+}
+
+// Feistel network over two 15-bit halves: a bijection on 30-bit values
+static uint32_t scrambleBits(uint32_t value)
+{
+    uint32_t left = value >> ISBN_SCRAMBLE_HALF_BITS;
+    uint32_t right = value & ((1u << ISBN_SCRAMBLE_HALF_BITS) - 1);
+
+    for (int round = 0; round < ISBN_SCRAMBLE_ROUNDS; round++) {
+        uint32_t mixed = left ^ scrambleRound(right, round);
+        left = right;
+        right = mixed;
+    }
+    return left << ISBN_SCRAMBLE_HALF_BITS | right;
+}
+
+// Map a sequence number to a generated ISBN-13 (979 prefix, check digit
+// included). Scrambling is repeated until the value falls below
+// ISBN_BODY_SPACE (cycle walking), which keeps it a bijection on the
+// 9-digit body, so distinct sequence numbers never give the same ISBN.
+uint64_t isbnScramble(uint64_t sequence)
+{
+    uint32_t body = (uint32_t)(sequence % ISBN_BODY_SPACE);
+
+    do {
+        body = scrambleBits(body);
+    } while (body >= ISBN_BODY_SPACE);
+
+    uint64_t first12 = ISBN_GENERATED_PREFIX * ISBN_BODY_SPACE + body;
+    return first12 * 10 + (uint64_t)isbnCheckDigit(first12);
+}
+
+// Take `count` sequence numbers from the catalog for a loader to use on its
+// own. The caller still checks the ISBN index before inserting, because
+// imported ISBNs can fall anywhere in the space.
+isbnRange isbnAllocateRange(catalog* cat, uint64_t count)
+{
+    isbnRange range;
+
+    range.next = cat->isbnSequence;
+    range.end = cat->isbnSequence + count;
+    cat->isbnSequence = range.end;
+    return range;
+}
+
+// Next ISBN from a range, or false once the range is used up
+bool isbnRangeNext(isbnRange* range, uint64_t* key)
+{
+    if (range->next == range->end) return false;
+    *key = isbnScramble(range->next++);
+    return true;
+}
+
+// Next free ISBN from a loader's range, taking another ISBN_RANGE_BLOCK
+// sequence numbers from the catalog when the range runs out. Like
+// generateISBN, skips ISBNs that are already taken.
+uint64_t isbnRangeGenerate(catalog* cat, isbnRange* range, const isbnIndex* isbnIdx)
+{
+    uint64_t isbn;
+
+    do {
+        if (!isbnRangeNext(range, &isbn)) {
+            *range = isbnAllocateRange(cat, ISBN_RANGE_BLOCK);
+            isbnRangeNext(range, &isbn);
+        }
+    } while (isbnIndexFind(isbnIdx, isbn) >= 0);
+    return isbn;
+}
+
+// Hand the unused end of a range back to the catalog, if no range has been
+// taken after it, so a finished loader leaves no gap in the sequence
+void isbnReleaseRange(catalog* cat, const isbnRange* range)
+{
+    if (cat->isbnSequence == range->end) cat->isbnSequence = range->next;
+}
+
+// Write an ISBN-13 as prefix-body-check (e.g. 979-123456789-7) into an
+// ISBN_TEXT_SIZE buffer. Only display code needs the text form.
+void formatISBN(uint64_t isbn, char* out)
+{
+    char digits[13];
+
+    digits[12] = (char)('0' + isbn % 10);
+    isbn /= 10;
+    for (int i = 10; i >= 0; i -= 2) {
+        memcpy(&digits[i], &digitPairs[(isbn % 100) * 2], 2);
+        isbn /= 100;
+    }
+
+    memcpy(out, digits, 3);
+    out[3] = '-';
+    memcpy(out + 4, digits + 3, 9);
+    out[13] = '-';
+    out[14] = digits[12];
+    out[15] = '\0';
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @SORTED INDEX FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+// Build the folded key for a field: lower-case it once and hash the result
+void foldKey(foldedKey* key, const char* text)
+{
+    uint32_t hash = 2166136261u;
+    size_t len = 0;
+
+    while (text[len] != '\0' && len < sizeof(key->text) - 1) {
+        char folded = (char)tolower((unsigned char)text[len]);
+        key->text[len] = folded;
+        hash = (hash ^ (uint8_t)folded) * 16777619u;
+        len++;
+    }
+
+    key->text[len] = '\0';
+    key->length = (uint8_t)len;
+    key->hash = hash;
+}
+
+// Byte order of two folded keys; no per-character case folding needed
+static int compareKeys(const foldedKey* a, const foldedKey* b)
+{
+    size_t len = (a->length < b->length) ? a->length : b->length;
+    int diff = memcmp(a->text, b->text, len);
+    if (diff != 0) return diff;
+    return (int)a->length - (int)b->length;
+}
+
+// Compare only the first prefix->length bytes of a key against prefix
+static int comparePrefix(const foldedKey* key, const foldedKey* prefix)
+{
+    size_t len = (key->length < prefix->length) ? key->length : prefix->length;
+    int diff = memcmp(key->text, prefix->text, len);
+    if (diff != 0) return diff;
+    return (key->length < prefix->length) ? -1 : 0;
+}
+
+// Equality check: hash first, then length, then bytes
+static bool keysEqual(const foldedKey* a, const foldedKey* b)
+{
+    return a->hash == b->hash
+        && a->length == b->length
+        && memcmp(a->text, b->text, a->length) == 0;
+}
+
+static const foldedKey* indexKey(const sortedIndex* idx, int index)
+{
+    return &(*idx->keys)[index];
+}
+
+// Order by folded key, then by position so equal titles keep insertion order
+static int compareEntries(const sortedIndex* idx, int a, int b)
+{
+    int diff = compareKeys(indexKey(idx, a), indexKey(idx, b));
+    if (diff != 0) return diff;
+    return (a > b) - (a < b);
+}
+
+// Stable merge sort of a batch of positions, using scratch as the work buffer
+static void sortPositions(const sortedIndex* idx, int* ids, int* scratch, size_t n)
+{
+    if (n < 2) return;
+
+    size_t half = n / 2;
+    sortPositions(idx, ids, scratch, half);
+    sortPositions(idx, ids + half, scratch, n - half);
+
+    size_t i = 0, j = half, k = 0;
+    while (i < half && j < n) {
+        scratch[k++] = (compareEntries(idx, ids[j], ids[i]) < 0) ? ids[j++] : ids[i++];
+    }
+    while (i < half) scratch[k++] = ids[i++];
+    while (j < n) scratch[k++] = ids[j++];
+    memcpy(ids, scratch, n * sizeof(int));
+}
+
+void sortedIndexInit(sortedIndex* idx, int* const* order, foldedKey* const* keys)
+{
+    idx->order = order;
+    idx->keys = keys;
+    idx->count = 0;
+}
+
+// Number of entries in order[0, count) that sort at or before position. The
+// batch is merged largest first, so the answer is usually near count: gallop
+// back from the end, then binary search the last step.
+static size_t entriesNotAfter(const sortedIndex* idx, const int* order, size_t count, int position)
+{
+    size_t high = count, step = 1;
+    while (step <= high && compareEntries(idx, order[high - step], position) > 0) {
+        high -= step;
+        step *= 2;
+    }
+
+    size_t low = (step <= high) ? high - step + 1 : 0;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (compareEntries(idx, order[mid], position) > 0) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return low;
+}
+
+// Add books [first, first + count) by sorting only the new batch and merging
+// it into the existing order from the back, so the catalog is never re-sorted.
+// Each batch entry's place is found by a galloping search and the existing
+// entries after it move up in one block, so a batch costs O(count log n) key
+// comparisons plus one memmove pass over the entries it lands in front of.
+// The order column always has room: it is sized with the catalog.
+void sortedIndexInsertBatch(sortedIndex* idx, int first, int count)
+{
+    if (count <= 0) return;
+
+    int* order = *idx->order;
+    size_t total = idx->count + (size_t)count;
+
+    int* batch = (int*)allocOrExit(2 * (size_t)count * sizeof(int));
+    int* scratch = batch + count;
+    for (int i = 0; i < count; i++) {
+        batch[i] = first + i;
+    }
+    sortPositions(idx, batch, scratch, (size_t)count);
+
+    // Merge from the back so existing entries are shifted at most once
+    size_t i = idx->count;
+    size_t j = (size_t)count;
+    size_t k = total;
+    while (j > 0) {
+        size_t keep = entriesNotAfter(idx, order, i, batch[j - 1]);
+        k -= i - keep;
+        memmove(order + k, order + keep, (i - keep) * sizeof(int));
+        i = keep;
+        order[--k] = batch[--j];
+    }
+
+    idx->count = total;
+    free(batch);
+}
+
+// First position whose key is >= key
+static size_t lowerBound(const sortedIndex* idx, const foldedKey* key)
+{
+    size_t low = 0, high = idx->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (compareKeys(indexKey(idx, (*idx->order)[mid]), key) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// First position whose key is > key (or, for a prefix, no longer starts with it)
+static size_t upperBound(const sortedIndex* idx, const foldedKey* key, bool prefix)
+{
+    size_t low = 0, high = idx->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        const foldedKey* field = indexKey(idx, (*idx->order)[mid]);
+        int diff = prefix ? comparePrefix(field, key) : compareKeys(field, key);
+        if (diff <= 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// All entries equal to key; the run of equal keys is walked with keysEqual
+indexRange sortedIndexExact(const sortedIndex* idx, const foldedKey* key)
+{
+    indexRange range;
+    range.first = lowerBound(idx, key);
+    range.last = range.first;
+    while (range.last < idx->count && keysEqual(indexKey(idx, (*idx->order)[range.last]), key)) {
+        range.last++;
+    }
+    return range;
+}
+
+// All entries starting with prefix
+indexRange sortedIndexPrefix(const sortedIndex* idx, const foldedKey* prefix)
+{
+    indexRange range = { lowerBound(idx, prefix), upperBound(idx, prefix, true) };
+    return range;
+}
+
+// All entries with low <= key <= high
+indexRange sortedIndexBetween(const sortedIndex* idx, const foldedKey* low, const foldedKey* high)
+{
+    indexRange range = { lowerBound(idx, low), upperBound(idx, high, false) };
+    if (range.last < range.first) range.last = range.first;
+    return range;
+}
+
+// Open a cursor on rows [range.first, range.last). With a NULL index the
+// rows are book positions, i.e. the order books were added.
+void cursorOpen(catalogCursor* cur, const sortedIndex* idx, indexRange range)
+{
+    cur->idx = idx;
+    cur->first = range.first;
+    cur->last = range.last;
+    cur->position = range.first;
+}
+
+// Move to the row `offset` rows into the cursor's range in O(1); returns
+// false (leaving the cursor at the end) if the offset is past the range
+bool cursorSeek(catalogCursor* cur, size_t offset)
+{
+    if (offset >= cur->last - cur->first) {
+        cur->position = cur->last;
+        return false;
+    }
+    cur->position = cur->first + offset;
+    return true;
+}
+
+size_t cursorCount(const catalogCursor* cur)
+{
+    return cur->last - cur->first;
+}
+
+// Book position of the next row, or -1 once the range is used up
+int cursorNext(catalogCursor* cur)
+{
+    if (cur->position >= cur->last) return -1;
+
+    size_t row = cur->position++;
+    return (cur->idx != NULL) ? (*cur->idx->order)[row] : (int)row;
+}
+
+// Build the in-memory indexes for a catalog that was just opened. The ISBN
+// hash is rebuilt from the ISBN column; the sorted orders are reused from the
+// file unless an interrupted update left them incomplete.
+void catalogLoadIndexes(catalog* cat, isbnIndex* isbnIdx, sortedIndex* titleIdx, sortedIndex* authorIdx)
+{
+    isbnIndexReserve(isbnIdx, (size_t)cat->count);
+    for (int i = 0; i < cat->count; i++) {
+        if (cat->isbns[i] != 0) isbnIndexInsert(isbnIdx, cat->isbns[i], i);
+    }
+
+    if (cat->indexedCount == cat->count) {
+        titleIdx->count = (size_t)cat->count;
+        authorIdx->count = (size_t)cat->count;
+        return;
+    }
+
+    catalogBeginIndexUpdate(cat);
+    titleIdx->count = 0;
+    authorIdx->count = 0;
+    sortedIndexInsertBatch(titleIdx, 0, cat->count);
+    sortedIndexInsertBatch(authorIdx, 0, cat->count);
+    catalogCommit(cat);
+}
+
+// Look a query up in a sorted index; a trailing '*' makes it a prefix search.
+// The query is folded once here and every match is ranked into res. When
+// nothing matches, the closest spellings are looked up in grams instead and
+// true is returned.
+static bool lookupSorted(const catalog* cat, const sortedIndex* idx, trigramIndex* grams, char* query, searchResult* res)
+{
+    size_t len = strlen(query);
+    bool prefix = (len > 0 && query[len - 1] == '*');
+    foldedKey key;
+
+    if (prefix) query[len - 1] = '\0';
+    foldKey(&key, query);
+    searchRange(idx, prefix ? sortedIndexPrefix(idx, &key) : sortedIndexExact(idx, &key), &key, res);
+
+    if (res->total > 0) return false;
+    fuzzySearch(grams, *idx->keys, cat->count, &key, res);
+    return true;
+}
+
+// List the hits of a finished search and let the user pick one. A single
+// match is returned straight away. Returns the chosen position or -1.
+static int pickResult(const catalog* cat, const searchResult* res)
+{
+    int choice = 0;
+
+    if (res->count == 0) {
+        printf(RED"\nBook is not found.\n"RESET);
+        return -1;
+    }
+    if (res->total == 1) {
+        printf(GREEN"\nBook is found!\n"RESET);
+        return res->hits[0].position;
+    }
+
+    if (res->count < res->total) {
+        printf(GREEN"\n%zu matching books, best %zu shown:\n"RESET, res->total, res->count);
+    } else {
+        printf(GREEN"\n%zu matching books:\n"RESET, res->total);
+    }
+    for (size_t i = 0; i < res->count; i++) {
+        int position = res->hits[i].position;
+        printf(CYAN"~~ %zu - "GREEN"%s"CYAN" by "GREEN"%s\n"RESET, i + 1,
+               cat->titles[position], cat->authors[position]);
+    }
+
+    printf(YELLOW"Select a book (0 to cancel): "RESET);
+    scanf("%d", &choice);
+    while (getchar() != '\n');  // Clear input buffer
+
+    return (choice >= 1 && (size_t)choice <= res->count) ? res->hits[choice - 1].position : -1;
+}
+
+// Search book by book title using the sorted title index
+int searchByTitle(const catalog* cat, const sortedIndex* titleIdx, trigramIndex* titleGrams)
+{
+    searchResult res;
+    char titleToSearch[50];  // Match size with book structure
+
+    printf(CYAN"\n<=======================================>\n"
+           "||             SEARCH BY TITLE            ||\n"
+           "<=======================================>\n"RESET);
+    printf(CYAN"Enter book title (end with * to match a prefix): "RESET);
+    scanf(" %49[^\n]", titleToSearch);  // Prevent buffer overflow
+    while (getchar() != '\n');  // Clear input buffer
+
+    double started = searchStarted();
+    resultInit(&res, SEARCH_DEFAULT_LIMIT);
+    bool fuzzy = lookupSorted(cat, titleIdx, titleGrams, titleToSearch, &res);
+    resultFinish(&res);
+    searchFinished(STAT_TITLE, started);
+    if (fuzzy && res.count > 0) printf(YELLOW"\nNo exact match; showing the closest spellings."RESET);
+
+    int index = pickResult(cat, &res);
+    resultFree(&res);
+    return index;
+}
+
+// Search book by author using the sorted author index
+int searchByAuthor(const catalog* cat, const sortedIndex* authorIdx, trigramIndex* authorGrams)
+{
+    searchResult res;
+    char authorToSearch[50];  // Match size with book structure
+
+    printf(CYAN"\n<=======================================>\n"
+           "||             SEARCH BY AUTHOR           ||\n"
+           "<=======================================>\n"RESET);
+    printf(CYAN"Enter author name (end with * to match a prefix): "RESET);
+    scanf(" %49[^\n]", authorToSearch);  // Prevent buffer overflow
+    while (getchar() != '\n');  // Clear input buffer
+
+    double started = searchStarted();
+    resultInit(&res, SEARCH_DEFAULT_LIMIT);
+    bool fuzzy = lookupSorted(cat, authorIdx, authorGrams, authorToSearch, &res);
+    resultFinish(&res);
+    searchFinished(STAT_AUTHOR, started);
+    if (fuzzy && res.count > 0) printf(YELLOW"\nNo exact match; showing the closest spellings."RESET);
+
+    int index = pickResult(cat, &res);
+    resultFree(&res);
+    return index;
+}
+
+// Search book by book isbn using the hash index
+int searchByISBN(isbnIndex* isbnIdx)
+{
+    int index = -1;
+    uint64_t key;
+    char isbnToSearch[ISBN_INPUT_SIZE];
+
+    printf(CYAN"\n<=======================================>\n"
+           "||              SEARCH BY ISBN             ||\n"
+           "<=======================================>\n"RESET);
+    printf(CYAN"Enter ISBN: "RESET);
+    scanf(" %31[^\n]", isbnToSearch);  // Prevent buffer overflow
+    while (getchar() != '\n');  // Clear input buffer
+
+    if (!parseISBN(isbnToSearch, &key))
+    {
+        printf(RED"\nNot a valid ISBN-13 or ISBN-10 (check the digits).\n"RESET);
+        return -1;
+    }
+
+    double started = searchStarted();
+    index = isbnIndexFind(isbnIdx, key);
+    searchFinished(STAT_ISBN, started);
+    if (index > -1)
+    {
+        printf(GREEN"\nBook is found!\n"RESET);
+        return index;
+    }
+
+    printf(RED"\nBook is not found.\n"RESET);
+    return -1;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @SUBSTRING SEARCH FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+// Plain byte-by-byte check, used when no vector unit is available
+static bool containsScalar(const char* hay, size_t hayLen, const char* needle, size_t needleLen)
+{
+    for (size_t i = 0; i + needleLen <= hayLen; i++) {
+        if (hay[i] == needle[0] && memcmp(hay + i + 1, needle + 1, needleLen - 1) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#if KEY_SIMD
+// Compare the needle's first and last byte against 16 candidate positions at
+// once and only memcmp the positions where both match. Loads may run up to
+// KEY_SIMD_PADDING bytes past the text, which the key columns reserve.
+static bool containsSSE2(const char* hay, size_t hayLen, const char* needle, size_t needleLen)
+{
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needleLen - 1]);
+
+    for (size_t i = 0; i + needleLen <= hayLen; i += 16) {
+        __m128i blockFirst = _mm_loadu_si128((const __m128i*)(hay + i));
+        __m128i blockLast = _mm_loadu_si128((const __m128i*)(hay + i + needleLen - 1));
+        unsigned mask = (unsigned)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast)));
+
+        while (mask != 0) {
+            size_t pos = i + (size_t)__builtin_ctz(mask);
+            if (pos + needleLen > hayLen) break;
+            if (needleLen <= 2 || memcmp(hay + pos + 1, needle + 1, needleLen - 2) == 0) return true;
+            mask &= mask - 1;
+        }
+    }
+    return false;
+}
+
+// Same filter as containsSSE2, 32 candidate positions per step
+__attribute__((target("avx2")))
+static bool containsAVX2(const char* hay, size_t hayLen, const char* needle, size_t needleLen)
+{
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[needleLen - 1]);
+
+    for (size_t i = 0; i + needleLen <= hayLen; i += 32) {
+        __m256i blockFirst = _mm256_loadu_si256((const __m256i*)(hay + i));
+        __m256i blockLast = _mm256_loadu_si256((const __m256i*)(hay + i + needleLen - 1));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst), _mm256_cmpeq_epi8(last, blockLast)));
+
+        while (mask != 0) {
+            size_t pos = i + (size_t)__builtin_ctz(mask);
+            if (pos + needleLen > hayLen) break;
+            if (needleLen <= 2 || memcmp(hay + pos + 1, needle + 1, needleLen - 2) == 0) return true;
+            mask &= mask - 1;
+        }
+    }
+    return false;
+}
+#endif
+
+// Pick the widest substring kernel this CPU supports
+void initContainsKernel(void)
+{
+    containsKernel = containsScalar;
+#if KEY_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        containsKernel = containsAVX2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        containsKernel = containsSSE2;
+    }
+#endif
+}
+
+// Prompt for a fragment and let the user pick from the titles/authors
+// containing it, best matches first. Returns the chosen position or -1.
+int searchContaining(const catalog* cat, bool byAuthor)
+{
+    char fragment[50];
+    foldedKey needle;
+    searchResult res;
+
+    printf(CYAN"\n<=======================================>\n"
+           "%s"
+           "<=======================================>\n"RESET,
+           byAuthor ? "||        SEARCH AUTHOR CONTAINS         ||\n"
+                    : "||         SEARCH TITLE CONTAINS          ||\n");
+    printf(CYAN"Enter part of the %s: "RESET, byAuthor ? "author name" : "book title");
+    scanf(" %49[^\n]", fragment);  // Prevent buffer overflow
+    while (getchar() != '\n');  // Clear input buffer
+
+    double started = searchStarted();
+    foldKey(&needle, fragment);
+    resultInit(&res, SEARCH_DEFAULT_LIMIT);
+    searchKeys(byAuthor ? cat->authorKeys : cat->titleKeys, cat->count, &needle, &res);
+    resultFinish(&res);
+    searchFinished(STAT_CONTAINS, started);
+
+    int index = pickResult(cat, &res);
+    resultFree(&res);
+    return index;
+}
+
+// Prompt for words of a title and let the user pick from the books whose
+// title has all of them ('|' separates alternatives). Returns the chosen
+// position or -1.
+int searchWords(const catalog* cat, wordIndex* words)
+{
+    char query[50];
+    searchResult res;
+
+    printf(CYAN"\n<=======================================>\n"
+           "||            SEARCH TITLE WORDS          ||\n"
+           "<=======================================>\n"RESET);
+    printf(CYAN"Enter words from the title (use | for either/or): "RESET);
+    scanf(" %49[^\n]", query);  // Prevent buffer overflow
+    while (getchar() != '\n');  // Clear input buffer
+
+    double started = searchStarted();
+    resultInit(&res, SEARCH_DEFAULT_LIMIT);
+    wordSearch(words, cat->titleKeys, cat->count, query, &res);
+    resultFinish(&res);
+    searchFinished(STAT_WORDS, started);
+
+    int index = pickResult(cat, &res);
+    resultFree(&res);
+    return index;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @RANKED SEARCH FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+// Match quality tiers, best last
+enum matchTier {MATCH_INSIDE = 1, MATCH_WORD = 2, MATCH_PREFIX = 3, MATCH_EXACT = 4};
+
+// Score how well a folded key matches a folded query, or 0 if the key does
+// not contain it. The tier decides first (whole field, start of the field,
+// start of a word, anywhere), then an earlier match, then a shorter field.
+uint32_t matchScore(const foldedKey* key, const foldedKey* query)
+{
+    size_t keyLen = key->length;
+    size_t queryLen = query->length;
+    size_t offset = 0;
+    enum matchTier tier;
+
+    if (keyLen < queryLen) return 0;
+    if (queryLen > 0 && memcmp(key->text, query->text, queryLen) != 0) {
+        if (containsKernel == NULL) initContainsKernel();
+        if (!containsKernel(key->text, keyLen, query->text, queryLen)) return 0;
+
+        // Find the first occurrence, preferring one that starts a word
+        size_t first = keyLen;
+        for (size_t i = 1; i + queryLen <= keyLen; i++) {
+            if (key->text[i] != query->text[0] || memcmp(key->text + i, query->text, queryLen) != 0) continue;
+            if (first == keyLen) first = i;
+            if (!isalnum((unsigned char)key->text[i - 1])) {
+                first = i;
+                break;
+            }
+        }
+        if (first == keyLen) return 0;
+        offset = first;
+        tier = isalnum((unsigned char)key->text[offset - 1]) ? MATCH_INSIDE : MATCH_WORD;
+    } else {
+        tier = (keyLen == queryLen) ? MATCH_EXACT : MATCH_PREFIX;
+    }
+
+    // Keys are shorter than 256 bytes, so each part fits in one byte
+    return ((uint32_t)tier << 16) | ((uint32_t)(255 - offset) << 8) | (uint32_t)(255 - (keyLen - queryLen));
+}
+
+// True if hit a ranks below hit b; equal scores keep the older book first
+static bool hitWorse(const searchHit* a, const searchHit* b)
+{
+    return (a->score != b->score) ? a->score < b->score : a->position > b->position;
+}
+
+static void heapSiftUp(searchHit* hits, size_t i)
+{
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!hitWorse(&hits[i], &hits[parent])) break;
+        searchHit tmp = hits[i];
+        hits[i] = hits[parent];
+        hits[parent] = tmp;
+        i = parent;
+    }
+}
+
+static void heapSiftDown(searchHit* hits, size_t count, size_t i)
+{
+    for (;;) {
+        size_t worst = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < count && hitWorse(&hits[left], &hits[worst])) worst = left;
+        if (right < count && hitWorse(&hits[right], &hits[worst])) worst = right;
+        if (worst == i) return;
+        searchHit tmp = hits[i];
+        hits[i] = hits[worst];
+        hits[worst] = tmp;
+        i = worst;
+    }
+}
+
+void resultInit(searchResult* res, size_t limit)
+{
+    res->limit = limit;
+    res->capacity = (limit > 0) ? limit : 64;
+    res->hits = allocOrExit(res->capacity * sizeof(searchHit));
+    res->count = 0;
+    res->total = 0;
+}
+
+// Consider one match. Once the result is full, a new hit only gets in by
+// replacing the weakest one kept: O(log K) per match.
+void resultOffer(searchResult* res, int position, uint32_t score)
+{
+    searchHit hit = {position, score};
+
+    res->total++;
+    if (res->limit > 0 && res->count == res->limit) {
+        if (hitWorse(&res->hits[0], &hit)) {
+            res->hits[0] = hit;
+            heapSiftDown(res->hits, res->count, 0);
+        }
+        return;
+    }
+
+    if (res->count == res->capacity) {
+        res->capacity *= 2;
+        res->hits = reallocOrExit(res->hits, res->capacity * sizeof(searchHit));
+    }
+    res->hits[res->count] = hit;
+    heapSiftUp(res->hits, res->count++);
+}
+
+// Turn the heap into a best-first list by popping the weakest hit to the back
+void resultFinish(searchResult* res)
+{
+    for (size_t end = res->count; end > 1; end--) {
+        searchHit tmp = res->hits[0];
+        res->hits[0] = res->hits[end - 1];
+        res->hits[end - 1] = tmp;
+        heapSiftDown(res->hits, end - 1, 0);
+    }
+}
+
+void resultFree(searchResult* res)
+{
+    free(res->hits);
+    res->hits = NULL;
+    res->count = 0;
+}
+
+// Add the hits of partial results, e.g. one per scan thread, to this one.
+// A top-K result offers them one by one; one that keeps every match appends
+// them all and rebuilds the heap once.
+void resultMerge(searchResult* into, const searchResult* parts, int count)
+{
+    for (int p = 0; p < count; p++) {
+        const searchResult* from = &parts[p];
+        size_t total = into->total + from->total;
+
+        if (into->limit > 0) {
+            for (size_t i = 0; i < from->count; i++) {
+                resultOffer(into, from->hits[i].position, from->hits[i].score);
+            }
+        } else if (from->count > 0) {
+            if (into->count + from->count > into->capacity) {
+                into->capacity = into->count + from->count;
+                into->hits = reallocOrExit(into->hits, into->capacity * sizeof(searchHit));
+            }
+            memcpy(into->hits + into->count, from->hits, from->count * sizeof(searchHit));
+            into->count += from->count;
+        }
+        into->total = total;
+    }
+
+    if (into->limit == 0) {
+        for (size_t i = into->count / 2; i > 0; i--) heapSiftDown(into->hits, into->count, i - 1);
+    }
+}
+
+// Chunk worker for searchKeys/searchCheckedOut. Chunks start on a multiple
+// of 64, so the checked-out filter walks whole bitmap words.
+static void scanKeysChunk(const void* arg, int first, int last, searchResult* res)
+{
+    const keyScan* scan = arg;
+
+    if (scan->available == NULL) {
+        for (int i = first; i < last; i++) {
+            uint32_t score = matchScore(&scan->keys[i], scan->query);
+            if (score != 0) resultOffer(res, i, score);
+        }
+        return;
+    }
+
+    for (int base = first; base < last; base += 64) {
+        uint64_t out = ~atomicLoad64(&scan->available[base / 64]);
+        if (last - base < 64) out &= ((uint64_t)1 << (last - base)) - 1;
+
+        while (out != 0) {
+            int i = base + lowestBit64(out);
+            out &= out - 1;
+            if (scan->query == NULL) {
+                resultOffer(res, i, 1);  // Equal scores list in the order added
+            } else {
+                uint32_t score = matchScore(&scan->keys[i], scan->query);
+                if (score != 0) resultOffer(res, i, score);
+            }
+        }
+    }
+}
+
+// Rank every book whose key contains the query, in one pass over the key
+// column spread across the scan threads. Keys and query are already folded.
+void searchKeys(const foldedKey* keys, int count, const foldedKey* query, searchResult* res)
+{
+    keyScan scan = {keys, query, NULL};
+    parallelScan(count, scanKeysChunk, &scan, res->limit, res);
+}
+
+// The checked-out books, or only those whose key contains the query, in the
+// order they were added. Only the status bitmap is read for books on the shelf.
+void searchCheckedOut(const catalog* cat, const foldedKey* keys, const foldedKey* query, searchResult* res)
+{
+    keyScan scan = {keys, query, cat->available};
+    parallelScan(cat->count, scanKeysChunk, &scan, res->limit, res);
+}
+
+// Rank the books in one range of a sorted index, e.g. an exact or prefix
+// match; every key in the range starts with the query.
+void searchRange(const sortedIndex* idx, indexRange range, const foldedKey* query, searchResult* res)
+{
+    for (size_t row = range.first; row < range.last; row++) {
+        int position = (*idx->order)[row];
+        resultOffer(res, position, matchScore(indexKey(idx, position), query));
+    }
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @PARALLEL SCAN FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+static uint64_t scanRange(uint32_t next, uint32_t end)
+{
+    return ((uint64_t)end << 32) | next;
+}
+
+// Take the next chunk from the front of a thread's own queue, or -1
+static int scanPop(scanQueue* queue)
+{
+    for (;;) {
+        uint64_t range = atomicLoad64(&queue->range);
+        uint32_t next = (uint32_t)range;
+        uint32_t end = (uint32_t)(range >> 32);
+        if (next >= end) return -1;
+        if (atomicSwap64(&queue->range, range, scanRange(next + 1, end))) return (int)next;
+    }
+}
+
+// Take the back half of another thread's queue: run its first chunk now and
+// keep the rest in our own (empty) queue. Returns -1 if it had nothing left.
+static int scanSteal(scanQueue* victim, scanQueue* own)
+{
+    for (;;) {
+        uint64_t range = atomicLoad64(&victim->range);
+        uint32_t next = (uint32_t)range;
+        uint32_t end = (uint32_t)(range >> 32);
+        if (next >= end) return -1;
+
+        uint32_t taken = (end - next + 1) / 2;
+        if (atomicSwap64(&victim->range, range, scanRange(next, end - taken))) {
+            atomicSwap64(&own->range, atomicLoad64(&own->range), scanRange(end - taken + 1, end));
+            return (int)(end - taken);
+        }
+    }
+}
+
+// One thread's part of a scan: its own chunks first, then other threads'
+static void scanWork(scanPool* pool, int self)
+{
+    searchResult* res = &pool->results[self];
+    int chunk;
+
+    for (;;) {
+        while ((chunk = scanPop(&pool->queues[self])) >= 0) {
+            int first = chunk * SCAN_CHUNK_ROWS;
+            int last = (pool->count - first < SCAN_CHUNK_ROWS) ? pool->count : first + SCAN_CHUNK_ROWS;
+            pool->fn(pool->arg, first, last, res);
+        }
+
+        // Out of work: steal from the next thread that still has some
+        chunk = -1;
+        for (int i = 1; i < pool->threads && chunk < 0; i++) {
+            chunk = scanSteal(&pool->queues[(self + i) % pool->threads], &pool->queues[self]);
+        }
+        if (chunk < 0) return;
+
+        int first = chunk * SCAN_CHUNK_ROWS;
+        int last = (pool->count - first < SCAN_CHUNK_ROWS) ? pool->count : first + SCAN_CHUNK_ROWS;
+        pool->fn(pool->arg, first, last, res);
+    }
+}
+
+#ifdef _WIN32
+#define scanLock(pool) AcquireSRWLockExclusive(&(pool)->lock)
+#define scanUnlock(pool) ReleaseSRWLockExclusive(&(pool)->lock)
+#define scanWait(pool, cond) SleepConditionVariableSRW(&(pool)->cond, &(pool)->lock, INFINITE, 0)
+#define scanSignal(pool, cond) WakeAllConditionVariable(&(pool)->cond)
+#else
+#define scanLock(pool) pthread_mutex_lock(&(pool)->lock)
+#define scanUnlock(pool) pthread_mutex_unlock(&(pool)->lock)
+#define scanWait(pool, cond) pthread_cond_wait(&(pool)->cond, &(pool)->lock)
+#define scanSignal(pool, cond) pthread_cond_broadcast(&(pool)->cond)
+#endif
+
+// Body of a helper thread: sleep until a scan starts, work on it, report back
+static void scanThreadLoop(scanPool* pool, int self)
+{
+    uint64_t seen = 0;
+
+    for (;;) {
+        scanLock(pool);
+        while (pool->generation == seen) scanWait(pool, wake);
+        seen = pool->generation;
+        scanUnlock(pool);
+
+        scanWork(pool, self);
+
+        scanLock(pool);
+        if (--pool->running == 0) scanSignal(pool, done);
+        scanUnlock(pool);
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI scanThread(LPVOID arg)
+{
+    scanThreadLoop(&scanEngine, (int)(intptr_t)arg);
+    return 0;
+}
+#else
+static void* scanThread(void* arg)
+{
+    scanThreadLoop(&scanEngine, (int)(intptr_t)arg);
+    return NULL;
+}
+#endif
+
+// Size the scan pool; 0 means one thread per processor. The helper threads
+// are started by the first scan big enough to need them.
+void scanPoolInit(int threads)
+{
+    if (threads <= 0) {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        threads = (int)info.dwNumberOfProcessors;
+#else
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    }
+    if (threads < 1) threads = 1;
+    if (threads > SCAN_MAX_THREADS) threads = SCAN_MAX_THREADS;
+    scanEngine.threads = threads;
+}
+
+static bool scanPoolStart(scanPool* pool)
+{
+#ifdef _WIN32
+    InitializeSRWLock(&pool->lock);
+    InitializeConditionVariable(&pool->wake);
+    InitializeConditionVariable(&pool->done);
+#else
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+#endif
+
+    for (int i = 1; i < pool->threads; i++) {
+#ifdef _WIN32
+        HANDLE thread = CreateThread(NULL, 0, scanThread, (LPVOID)(intptr_t)i, 0, NULL);
+        bool created = (thread != NULL);
+        if (created) CloseHandle(thread);
+#else
+        pthread_t thread;
+        bool created = (pthread_create(&thread, NULL, scanThread, (void*)(intptr_t)i) == 0);
+        if (created) pthread_detach(thread);
+#endif
+        if (!created) {
+            pool->threads = i;  // Scan with the threads we did get
+            break;
+        }
+    }
+    pool->started = true;
+    return pool->threads > 1;
+}
+
+// Run fn over rows [0, count) in chunks on every scan thread and merge the
+// matches into res; each thread keeps its own best `limit` (0 for all).
+// Ties rank by position, so the merged result is the same as one thread's.
+void parallelScan(int count, scanChunkFn fn, const void* arg, size_t limit, searchResult* res)
+{
+    scanPool* pool = &scanEngine;
+
+    if (pool->threads == 0) scanPoolInit(0);
+    if (pool->threads <= 1 || count < SCAN_MIN_ROWS || (!pool->started && !scanPoolStart(pool))) {
+        fn(arg, 0, count, res);
+        return;
+    }
+
+    // Deal out contiguous runs of chunks, so each thread starts on its own
+    // part of the columns and only steals once it is done
+    int chunks = (count + SCAN_CHUNK_ROWS - 1) / SCAN_CHUNK_ROWS;
+    for (int t = 0; t < pool->threads; t++) {
+        uint32_t next = (uint32_t)((int64_t)chunks * t / pool->threads);
+        uint32_t end = (uint32_t)((int64_t)chunks * (t + 1) / pool->threads);
+        pool->queues[t].range = scanRange(next, end);
+        resultInit(&pool->results[t], limit);
+    }
+    pool->fn = fn;
+    pool->arg = arg;
+    pool->count = count;
+    pool->limit = limit;
+
+    scanLock(pool);
+    pool->running = pool->threads - 1;
+    pool->generation++;
+    scanSignal(pool, wake);
+    scanUnlock(pool);
+
+    scanWork(pool, 0);
+
+    scanLock(pool);
+    while (pool->running > 0) scanWait(pool, done);
+    scanUnlock(pool);
+
+    resultMerge(res, pool->results, pool->threads);
+    for (int t = 0; t < pool->threads; t++) {
+        resultFree(&pool->results[t]);
+    }
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @FUZZY SEARCH FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+// Bucket of the trigram starting at text
+static uint32_t trigramBucket(const char* text)
+{
+    uint32_t gram = ((uint32_t)(uint8_t)text[0] << 16) | ((uint32_t)(uint8_t)text[1] << 8) | (uint8_t)text[2];
+    return (gram * 2654435761u) >> 16;  // Multiplicative hash down to 16 bits
+}
+
+void trigramIndexInit(trigramIndex* idx)
+{
+    idx->buckets = NULL;  // Allocated by the first trigramIndexSync
+    idx->count = 0;
+    idx->shared = NULL;
+    idx->sharedCapacity = 0;
+}
+
+// Index the books added since the last sync: count the new postings of
+// every bucket first so each list grows at most once, then append.
+void trigramIndexSync(trigramIndex* idx, const foldedKey* keys, int count)
+{
+    if (count <= idx->count) return;
+
+    if (idx->buckets == NULL) {
+        idx->buckets = calloc(TRIGRAM_BUCKETS, sizeof(trigramPostings));
+        if (idx->buckets == NULL) {
+            printf(RED"Memory allocation failed\n"RESET);
+            exit(1);
+        }
+    }
+
+    uint32_t* added = calloc(TRIGRAM_BUCKETS, sizeof(uint32_t));
+    if (added == NULL) {
+        printf(RED"Memory allocation failed\n"RESET);
+        exit(1);
+    }
+    for (int i = idx->count; i < count; i++) {
+        for (size_t j = 0; j + 3 <= keys[i].length; j++) added[trigramBucket(keys[i].text + j)]++;
+    }
+    for (uint32_t b = 0; b < TRIGRAM_BUCKETS; b++) {
+        trigramPostings* list = &idx->buckets[b];
+        if (added[b] == 0 || list->count + added[b] <= list->capacity) continue;
+        uint32_t capacity = list->capacity ? list->capacity : 4;
+        while (capacity < list->count + added[b]) capacity *= 2;
+        list->positions = reallocOrExit(list->positions, capacity * sizeof(int));
+        list->capacity = capacity;
+    }
+    free(added);
+
+    for (int i = idx->count; i < count; i++) {
+        for (size_t j = 0; j + 3 <= keys[i].length; j++) {
+            trigramPostings* list = &idx->buckets[trigramBucket(keys[i].text + j)];
+            // A trigram repeated within one key is listed once
+            if (list->count == 0 || list->positions[list->count - 1] != i) list->positions[list->count++] = i;
+        }
+    }
+    idx->count = count;
+}
+
+void trigramIndexFree(trigramIndex* idx)
+{
+    if (idx->buckets != NULL) {
+        for (uint32_t b = 0; b < TRIGRAM_BUCKETS; b++) free(idx->buckets[b].positions);
+    }
+    free(idx->buckets);
+    free(idx->shared);
+    trigramIndexInit(idx);
+}
+
+// Edits allowed for a query of m bytes: short queries tolerate less
+static int fuzzyMaxEdits(size_t m)
+{
+    if (m < 3) return 0;
+    if (m <= 4) return 1;
+    if (m <= 10) return 2;
+    return 3;
+}
+
+// Smallest edit distance between the query and any substring of text, by
+// Myers' bit-parallel algorithm: one 64-bit word holds a whole column of the
+// dynamic-programming table, so each text byte costs a few word operations.
+// peq holds, per byte value, the query positions where that byte occurs.
+static int fuzzyDistance(const uint64_t* peq, size_t m, const char* text, size_t length)
+{
+    uint64_t pv = ~0ULL;
+    uint64_t mv = 0;
+    uint64_t high = 1ULL << (m - 1);
+    int score = (int)m;
+    int best = (int)m;
+
+    for (size_t j = 0; j < length; j++) {
+        uint64_t eq = peq[(uint8_t)text[j]];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+
+        if (ph & high) score++;
+        else if (mh & high) score--;
+        if (score < best) best = score;
+
+        // No carry into row 0: a match may start anywhere in the text
+        ph <<= 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+    }
+    return best;
+}
+
+// Binary search for a book in one sorted posting list
+static bool postingsContain(const trigramPostings* list, int position)
+{
+    uint32_t low = 0;
+    uint32_t high = list->count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (list->positions[mid] < position) low = mid + 1;
+        else high = mid;
+    }
+    return low < list->count && list->positions[low] == position;
+}
+
+// Offer a verified match: fewer edits first, then the shorter field
+static void fuzzyOffer(searchResult* res, const foldedKey* keys, int position, int distance)
+{
+    resultOffer(res, position, ((uint32_t)(16 - distance) << 16) | (uint32_t)(255 - keys[position].length));
+}
+
+// Rank the books whose key is within a few edits of containing the query.
+// An edit changes at most three trigrams, so a close match still shares
+// most of the query's trigrams: candidates are books sharing at least
+// `need` of them. Only the shortest lists are scanned to find candidates
+// (a book missing from all of them cannot reach `need`); the longer lists
+// are probed per candidate by binary search. Survivors are verified with
+// fuzzyDistance. Queries too short to have trigrams scan every key.
+void fuzzySearch(trigramIndex* idx, const foldedKey* keys, int count, const foldedKey* query, searchResult* res)
+{
+    size_t m = query->length;
+    int maxEdits = fuzzyMaxEdits(m);
+    uint64_t peq[256] = {0};
+
+    if (m == 0) return;
+    for (size_t i = 0; i < m; i++) peq[(uint8_t)query->text[i]] |= 1ULL << i;
+
+    if (m < 3) {
+        for (int i = 0; i < count; i++) {
+            int distance = fuzzyDistance(peq, m, keys[i].text, keys[i].length);
+            if (distance <= maxEdits) fuzzyOffer(res, keys, i, distance);
+        }
+        return;
+    }
+
+    trigramIndexSync(idx, keys, count);
+    if (idx->sharedCapacity < count) {
+        free(idx->shared);
+        idx->shared = calloc((size_t)count, 1);
+        if (idx->shared == NULL) {
+            printf(RED"Memory allocation failed\n"RESET);
+            exit(1);
+        }
+        idx->sharedCapacity = count;
+    }
+
+    // The query's distinct trigram lists, shortest first
+    const trigramPostings* lists[sizeof(query->text)];
+    int n = 0;
+    for (size_t i = 0; i + 3 <= m; i++) {
+        const trigramPostings* list = &idx->buckets[trigramBucket(query->text + i)];
+        bool seen = false;
+        for (int l = 0; l < n; l++) seen = seen || (lists[l] == list);
+        if (seen) continue;
+
+        int at = n++;
+        while (at > 0 && lists[at - 1]->count > list->count) {
+            lists[at] = lists[at - 1];
+            at--;
+        }
+        lists[at] = list;
+    }
+
+    // The bound is weak for short queries; still ask for one shared trigram
+    int need = n - 3 * maxEdits;
+    if (need < 1) need = 1;
+    int scanned = n - need + 1;
+
+    size_t bound = 0;
+    for (int l = 0; l < scanned; l++) bound += lists[l]->count;
+    int* candidates = allocOrExit((bound > 0 ? bound : 1) * sizeof(int));
+    size_t found = 0;
+
+    for (int l = 0; l < scanned; l++) {
+        for (uint32_t p = 0; p < lists[l]->count; p++) {
+            int position = lists[l]->positions[p];
+            if (idx->shared[position]++ == 0) candidates[found++] = position;
+        }
+    }
+
+    for (size_t c = 0; c < found; c++) {
+        int position = candidates[c];
+        int shared = idx->shared[position];
+        idx->shared[position] = 0;
+
+        for (int l = scanned; l < n && shared < need; l++) {
+            if (shared + (n - l) < need) break;
+            if (postingsContain(lists[l], position)) shared++;
+        }
+        if (shared < need) continue;
+
+        int distance = fuzzyDistance(peq, m, keys[position].text, keys[position].length);
+        if (distance <= maxEdits) fuzzyOffer(res, keys, position, distance);
+    }
+    free(candidates);
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @WORD INDEX FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+// Letters, digits and any non-ASCII byte (so UTF-8 words stay whole)
+static bool isWordByte(char c)
+{
+    return isalnum((unsigned char)c) || (unsigned char)c >= 0x80;
+}
+
+// Length of the word starting at text[*at], skipping separators first;
+// 0 at the end of the text
+static size_t nextWord(const char* text, size_t length, size_t* at)
+{
+    while (*at < length && !isWordByte(text[*at])) (*at)++;
+    size_t end = *at;
+    while (end < length && isWordByte(text[end])) end++;
+    return end - *at;
+}
+
+static uint32_t wordHash(const char* word, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) hash = (hash ^ (uint8_t)word[i]) * 16777619u;
+    return hash;
+}
+
+static void postingAppend(postingList* list, int id)
+{
+    uint32_t gap;
+
+    // Room for one varint (at most 5 bytes) and, at a block start, a skip
+    if (list->length + 5 > list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 8;
+        list->bytes = reallocOrExit(list->bytes, list->capacity);
+    }
+    if (list->count % POSTING_BLOCK == 0) {
+        if (list->count > 0) {
+            uint32_t block = list->count / POSTING_BLOCK;
+            if (block > list->skipCapacity) {
+                list->skipCapacity = list->skipCapacity ? list->skipCapacity * 2 : 4;
+                list->skips = reallocOrExit(list->skips, list->skipCapacity * sizeof(postingSkip));
+            }
+            list->skips[block - 1].first = id;
+            list->skips[block - 1].offset = list->length;
+        }
+        gap = (uint32_t)id;
+    } else {
+        gap = (uint32_t)(id - list->last);
+    }
+
+    while (gap >= 0x80) {
+        list->bytes[list->length++] = (uint8_t)(gap | 0x80);
+        gap >>= 7;
+    }
+    list->bytes[list->length++] = (uint8_t)gap;
+    list->last = id;
+    list->count++;
+}
+
+static uint32_t readVarint(const uint8_t* bytes, uint32_t* offset)
+{
+    uint32_t value = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+        byte = bytes[(*offset)++];
+        value |= (uint32_t)(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return value;
+}
+
+static int cursorOpenList(postingCursor* cur, const postingList* list)
+{
+    cur->list = list;
+    cur->index = 0;
+    cur->offset = 0;
+    cur->value = (list->count > 0) ? (int)readVarint(list->bytes, &cur->offset) : POSTING_END;
+    return cur->value;
+}
+
+static int postingNext(postingCursor* cur)
+{
+    if (cur->value == POSTING_END) return POSTING_END;
+    if (++cur->index >= cur->list->count) {
+        cur->value = POSTING_END;
+    } else if (cur->index % POSTING_BLOCK == 0) {
+        cur->value = (int)readVarint(cur->list->bytes, &cur->offset);
+    } else {
+        cur->value += (int)readVarint(cur->list->bytes, &cur->offset);
+    }
+    return cur->value;
+}
+
+// Move to the first ID >= target. Blocks are skipped by galloping over the
+// skip table (1, 2, 4, ... blocks ahead, then a binary search), so only the
+// block that can hold the target is decoded.
+static int postingSeek(postingCursor* cur, int target)
+{
+    if (cur->value >= target) return cur->value;
+
+    const postingList* list = cur->list;
+    uint32_t block = cur->index / POSTING_BLOCK;
+    uint32_t blocks = (list->count + POSTING_BLOCK - 1) / POSTING_BLOCK;
+
+    // skips[b - 1] describes block b
+    if (block + 1 < blocks && list->skips[block].first <= target) {
+        uint32_t low = block + 1;
+        uint32_t step = 1;
+        while (low + step < blocks && list->skips[low + step - 1].first <= target) {
+            low += step;
+            step *= 2;
+        }
+        uint32_t high = (low + step < blocks) ? low + step : blocks;  // First block known or assumed > target
+        while (high - low > 1) {
+            uint32_t mid = low + (high - low) / 2;
+            if (list->skips[mid - 1].first <= target) low = mid;
+            else high = mid;
+        }
+
+        cur->index = low * POSTING_BLOCK;
+        cur->offset = list->skips[low - 1].offset;
+        cur->value = (int)readVarint(list->bytes, &cur->offset);
+    }
+
+    while (cur->value < target) postingNext(cur);
+    return cur->value;
+}
+
+void wordIndexInit(wordIndex* idx)
+{
+    idx->capacity = WORD_INDEX_INITIAL_CAPACITY;
+    idx->slots = allocOrExit(idx->capacity * sizeof(int32_t));
+    memset(idx->slots, 0xff, idx->capacity * sizeof(int32_t));  // All -1
+    idx->entries = NULL;
+    idx->entryCount = 0;
+    idx->entryCapacity = 0;
+    idx->text = NULL;
+    idx->textLength = 0;
+    idx->textCapacity = 0;
+    idx->count = 0;
+}
+
+void wordIndexFree(wordIndex* idx)
+{
+    for (size_t i = 0; i < idx->entryCount; i++) {
+        free(idx->entries[i].books.bytes);
+        free(idx->entries[i].books.skips);
+    }
+    free(idx->entries);
+    free(idx->text);
+    free(idx->slots);
+    idx->slots = NULL;
+    idx->entries = NULL;
+    idx->text = NULL;
+    idx->capacity = 0;
+    idx->entryCount = 0;
+}
+
+// Entry of a word, or NULL if no title has it
+static wordEntry* wordIndexFind(const wordIndex* idx, const char* word, size_t length)
+{
+    uint32_t hash = wordHash(word, length);
+    size_t mask = idx->capacity - 1;
+    size_t pos = hash & mask;
+
+    while (idx->slots[pos] >= 0) {
+        wordEntry* entry = &idx->entries[idx->slots[pos]];
+        if (entry->hash == hash && entry->wordLength == length
+            && memcmp(idx->text + entry->wordOffset, word, length) == 0) {
+            return entry;
+        }
+        pos = (pos + 1) & mask;
+    }
+    return NULL;
+}
+
+// Entry of a word, added with an empty posting list if it is new
+static wordEntry* wordIndexAdd(wordIndex* idx, const char* word, size_t length)
+{
+    wordEntry* found = wordIndexFind(idx, word, length);
+    if (found != NULL) return found;
+
+    // Keep the load factor at or below 1/2, as the ISBN index does
+    if ((idx->entryCount + 1) * 2 > idx->capacity) {
+        size_t capacity = idx->capacity * 2;
+        int32_t* slots = allocOrExit(capacity * sizeof(int32_t));
+        memset(slots, 0xff, capacity * sizeof(int32_t));
+        for (size_t i = 0; i < idx->entryCount; i++) {
+            size_t pos = idx->entries[i].hash & (capacity - 1);
+            while (slots[pos] >= 0) pos = (pos + 1) & (capacity - 1);
+            slots[pos] = (int32_t)i;
+        }
+        free(idx->slots);
+        idx->slots = slots;
+        idx->capacity = capacity;
+    }
+    if (idx->entryCount == idx->entryCapacity) {
+        idx->entryCapacity = idx->entryCapacity ? idx->entryCapacity * 2 : 256;
+        idx->entries = reallocOrExit(idx->entries, idx->entryCapacity * sizeof(wordEntry));
+    }
+    if (idx->textLength + length > idx->textCapacity) {
+        while (idx->textLength + length > idx->textCapacity) {
+            idx->textCapacity = idx->textCapacity ? idx->textCapacity * 2 : 4096;
+        }
+        idx->text = reallocOrExit(idx->text, idx->textCapacity);
+    }
+
+    wordEntry* entry = &idx->entries[idx->entryCount];
+    memset(entry, 0, sizeof(*entry));
+    entry->hash = wordHash(word, length);
+    entry->wordOffset = (uint32_t)idx->textLength;
+    entry->wordLength = (uint8_t)length;
+    memcpy(idx->text + idx->textLength, word, length);
+    idx->textLength += length;
+
+    size_t pos = entry->hash & (idx->capacity - 1);
+    while (idx->slots[pos] >= 0) pos = (pos + 1) & (idx->capacity - 1);
+    idx->slots[pos] = (int32_t)idx->entryCount++;
+    return entry;
+}
+
+// Index the words of the books added since the last sync. IDs only grow,
+// so every posting list stays sorted and a repeated word is appended once.
+void wordIndexSync(wordIndex* idx, const foldedKey* keys, int count)
+{
+    for (int i = idx->count; i < count; i++) {
+        size_t at = 0;
+        size_t length;
+        while ((length = nextWord(keys[i].text, keys[i].length, &at)) > 0) {
+            postingList* books = &wordIndexAdd(idx, keys[i].text + at, length)->books;
+            if (books->count == 0 || books->last != i) postingAppend(books, i);
+            at += length;
+        }
+    }
+    if (count > idx->count) idx->count = count;
+}
+
+// Books holding every one of n posting lists, by leapfrogging: each cursor
+// in turn seeks to the highest ID seen so far until all of them agree.
+// Appends the IDs to out and returns how many there were.
+static size_t intersectPostings(const postingList** lists, int n, int** out, size_t* outCount, size_t* outCapacity)
+{
+    postingCursor cursors[WORD_QUERY_TERMS];
+    size_t found = 0;
+    int target = POSTING_END;
+
+    for (int i = 0; i < n; i++) {
+        int first = cursorOpenList(&cursors[i], lists[i]);
+        if (i == 0 || first > target) target = first;
+    }
+
+    int agree = 0;
+    int i = 0;
+    while (target != POSTING_END) {
+        int value = postingSeek(&cursors[i], target);
+        if (value == target) {
+            if (++agree < n) {
+                i = (i + 1) % n;
+                continue;
+            }
+            if (*outCount == *outCapacity) {
+                *outCapacity = *outCapacity ? *outCapacity * 2 : 256;
+                *out = reallocOrExit(*out, *outCapacity * sizeof(int));
+            }
+            (*out)[(*outCount)++] = target;
+            found++;
+            value = postingNext(&cursors[i]);
+        }
+        target = value;
+        agree = 1;
+        i = (i + 1) % n;
+    }
+    return found;
+}
+
+static int compareIds(const void* a, const void* b)
+{
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// Rank the books whose title has every word of the query. '|' separates
+// alternatives, e.g. "harry potter | gardening". Each group of words is
+// intersected with the shortest list leading; books that match several
+// alternatives rank first, then shorter titles.
+void wordSearch(wordIndex* idx, const foldedKey* keys, int count, const char* query, searchResult* res)
+{
+    foldedKey folded;
+    int* ids = NULL;
+    size_t idCount = 0;
+    size_t idCapacity = 0;
+
+    wordIndexSync(idx, keys, count);
+    foldKey(&folded, query);
+
+    const char* group = folded.text;
+    while (*group != '\0') {
+        const char* bar = strchr(group, '|');
+        size_t groupLength = (bar != NULL) ? (size_t)(bar - group) : strlen(group);
+        const postingList* lists[WORD_QUERY_TERMS];
+        int n = 0;
+        bool missing = false;
+        size_t at = 0;
+        size_t length;
+
+        while (n < WORD_QUERY_TERMS && (length = nextWord(group, groupLength, &at)) > 0) {
+            wordEntry* entry = wordIndexFind(idx, group + at, length);
+            at += length;
+            if (entry == NULL) {
+                missing = true;
+                break;
+            }
+
+            // Shortest list first; a word given twice is intersected once
+            bool seen = false;
+            for (int l = 0; l < n; l++) seen = seen || (lists[l] == &entry->books);
+            if (seen) continue;
+            int pos = n++;
+            while (pos > 0 && lists[pos - 1]->count > entry->books.count) {
+                lists[pos] = lists[pos - 1];
+                pos--;
+            }
+            lists[pos] = &entry->books;
+        }
+        if (!missing && n > 0) intersectPostings(lists, n, &ids, &idCount, &idCapacity);
+
+        group += groupLength;
+        if (*group == '|') group++;
+    }
+
+    // Alternatives can find the same book: count how many did
+    qsort(ids, idCount, sizeof(int), compareIds);
+    for (size_t i = 0; i < idCount;) {
+        size_t run = i + 1;
+        while (run < idCount && ids[run] == ids[i]) run++;
+        resultOffer(res, ids[i], ((uint32_t)(run - i) << 8) | (uint32_t)(255 - keys[ids[i]].length));
+        i = run;
+    }
+    free(ids);
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @STORE FUNCTION
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+void store(catalog* cat, isbnIndex* isbnIdx, sortedIndex* titleIdx, sortedIndex* authorIdx, wordIndex* words) {
+    int count = 0;
+    printf(CYAN"\n<=======================================>\n"
+           "||               ADD BOOKS                ||\n"
+           "<=======================================>\n"RESET);
+    printf(CYAN"Enter the number of books to add: "RESET);
+    scanf("%d", &count);
+    while (getchar() != '\n');  // Clear input buffer
+    
+    if (count <= 0) {
+        printf(RED"\nInvalid number of books.\n"RESET);
+        return;
+    }
+    
+    if (count > INT_MAX - cat->count) {
+        printf(RED"\nToo many books. The catalog can hold at most %d books.\n"RESET, INT_MAX);
+        return;
+    }
+
+    // Grow once for a typical batch instead of on every append. The typed
+    // count is not trusted further: on a mapped catalog reserving extends
+    // the file, so a typo must not grow it ahead of books that exist.
+    catalogReserve(cat, cat->count + (count < STORE_RESERVE_BOOKS ? count : STORE_RESERVE_BOOKS));
+
+    int startCount = cat->count;
+    
+    for (int i = 0; i < count; i++)
+    {
+        char title[50];
+        char author[50];
+
+        clearScreen();
+        displayHeader();
+        printf(CYAN"\n<=======================================>\n"
+               "||               ADD BOOKS                ||\n"
+               "<=======================================>\n"RESET);
+        printf(YELLOW"\nBook #%d of %d:\n"RESET, i + 1, count);
+        
+        printf(YELLOW"Book Title: "RESET);
+        if (scanf(" %49[^\n]", title) != 1) break;  // Input closed: keep the books entered so far
+        while (getchar() != '\n');  // Clear input buffer
+        
+        printf(YELLOW"Author: "RESET);
+        if (scanf(" %49[^\n]", author) != 1) break;
+        while (getchar() != '\n');  // Clear input buffer
+
+        // Generated ISBNs are never already in the index
+        uint64_t started = statsClock();
+        int index = catalogAppend(cat, title, author);
+        isbnIndexInsert(isbnIdx, generateISBN(cat, isbnIdx, index), index);
+        statsRecord(STAT_ADD, started);
+    }
+    
+    // Merge the whole batch into the sorted indexes at once, then publish it
+    count = cat->count - startCount;
+    uint64_t started = statsClock();
+    catalogBeginIndexUpdate(cat);
+    sortedIndexInsertBatch(titleIdx, startCount, count);
+    sortedIndexInsertBatch(authorIdx, startCount, count);
+    catalogCommit(cat);
+    wordIndexSync(words, cat->titleKeys, cat->count);
+    statsRecord(STAT_MERGE, started);
+
+    printf(GREEN"\nSuccessfully added %d books. Total books: %d\n"RESET, count, cat->count);
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @IMPORT FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+// Move the unread tail to the front of the buffer and read more after it,
+// doubling the buffer when a single row does not fit
+static void importFill(importReader* reader)
+{
+    size_t pending = reader->end - reader->start;
+
+    if (reader->start > 0) {
+        memmove(reader->buffer, reader->buffer + reader->start, pending);
+        reader->start = 0;
+        reader->end = pending;
+    }
+    if (reader->end == reader->capacity) {
+        reader->capacity *= 2;
+        reader->buffer = reallocOrExit(reader->buffer, reader->capacity + 1);
+    }
+
+    size_t got = fread(reader->buffer + reader->end, 1, reader->capacity - reader->end, reader->file);
+    reader->end += got;
+    if (got == 0) reader->eof = true;
+}
+
+// Split one row in place. Quoted fields may hold delimiters, newlines and
+// doubled quotes (""), which are unescaped where they lie.
+static int importSplitRow(char* row, char delimiter, char** fields, int maxFields)
+{
+    int count = 0;
+    char* p = row;
+
+    while (true) {
+        char* field = p;
+        char* out = p;
+
+        if (*p == '"') {
+            p++;
+            while (*p != '\0') {
+                if (*p == '"') {
+                    if (p[1] != '"') {
+                        p++;
+                        break;
+                    }
+                    p++;
+                }
+                *out++ = *p++;
+            }
+            while (*p != '\0' && *p != delimiter) p++;
+        } else {
+            while (*p != '\0' && *p != delimiter) p++;
+            out = p;
+        }
+
+        bool last = (*p == '\0');
+        *out = '\0';
+        if (count < maxFields) fields[count++] = field;
+        if (last) return count;
+        p++;
+    }
+}
+
+// Read the next row into `fields`. The fields point into the reader's
+// buffer and are only valid until the next call. Returns -1 at end of file.
+static int importNextRow(importReader* reader, char** fields, int maxFields)
+{
+    size_t scanned = reader->start;
+    bool quoted = false;
+
+    while (true) {
+        size_t i = scanned;
+        for (; i < reader->end; i++) {
+            char c = reader->buffer[i];
+            if (c == '"') {
+                quoted = !quoted;
+            } else if (c == '\n' && !quoted) {
+                break;
+            }
+        }
+
+        // A full row, or the last row of a file without a final newline
+        if (i < reader->end || (reader->eof && reader->start < reader->end)) {
+            char* row = reader->buffer + reader->start;
+            size_t length = i - reader->start;
+
+            reader->start = (i < reader->end) ? i + 1 : reader->end;
+            row[length] = '\0';
+            if (length > 0 && row[length - 1] == '\r') row[length - 1] = '\0';
+            return importSplitRow(row, reader->delimiter, fields, maxFields);
+        }
+        if (reader->eof) return -1;
+
+        // Keep the scan position across the refill so long rows are scanned once
+        scanned = i - reader->start;
+        importFill(reader);
+        scanned += reader->start;
+    }
+}
+
+// Strip surrounding blanks in place; line breaks inside a quoted field
+// become spaces so every book still prints on its own lines
+static char* trimField(char* text)
+{
+    while (*text == ' ' || *text == '\t') text++;
+
+    size_t len = 0;
+    for (; text[len] != '\0'; len++) {
+        if (text[len] == '\n' || text[len] == '\r') text[len] = ' ';
+    }
+    while (len > 0 && (text[len - 1] == ' ' || text[len - 1] == '\t')) len--;
+    text[len] = '\0';
+    return text;
+}
+
+static bool foldedFieldIs(const char* field, const char* name)
+{
+    foldedKey key;
+    foldKey(&key, field);
+    return strcmp(key.text, name) == 0;
+}
+
+// Load every row of a CSV or TSV file into the catalog. Columns are title,
+// author and an optional ISBN, in that order unless the first row is a
+// header naming them. Rows without an ISBN get a generated one; rows with
+// an unreadable or duplicate ISBN are skipped. The sorted indexes are merged
+// once at the end and the whole import is published with one commit.
+bool importCatalog(catalog* cat, isbnIndex* isbnIdx, sortedIndex* titleIdx, sortedIndex* authorIdx, const char* path)
+{
+    importReader reader;
+    char* fields[IMPORT_MAX_FIELDS];
+    int titleColumn = 0;
+    int authorColumn = 1;
+    int isbnColumn = 2;
+    int rows = 0;
+    int skipped = 0;
+    int generated = 0;
+    isbnRange isbns = {0, 0};  // Sequence numbers for rows without an ISBN
+
+    memset(&reader, 0, sizeof(reader));
+    reader.file = fopen(path, "rb");
+    if (reader.file == NULL) {
+        printf("%sCould not open import file %s.\n%s", terminalColor(stdout, RED), path, terminalColor(stdout, RESET));
+        return false;
+    }
+    reader.capacity = IMPORT_BUFFER_SIZE;
+    reader.buffer = allocOrExit(reader.capacity + 1);
+
+    double started = nowSeconds();
+    int startCount = cat->count;
+
+    // Tab-separated if the first line has more tabs than commas
+    importFill(&reader);
+    size_t tabs = 0;
+    size_t commas = 0;
+    for (size_t i = 0; i < reader.end && reader.buffer[i] != '\n'; i++) {
+        if (reader.buffer[i] == '\t') tabs++;
+        if (reader.buffer[i] == ',') commas++;
+    }
+    reader.delimiter = (tabs > commas) ? '\t' : ',';
+
+    int fieldCount;
+    bool firstRow = true;
+    while ((fieldCount = importNextRow(&reader, fields, IMPORT_MAX_FIELDS)) >= 0) {
+        // A header row names the columns
+        if (firstRow) {
+            firstRow = false;
+            bool header = false;
+            for (int f = 0; f < fieldCount; f++) {
+                char* name = trimField(fields[f]);
+                if (foldedFieldIs(name, "title")) {
+                    titleColumn = f;
+                    header = true;
+                } else if (foldedFieldIs(name, "author")) {
+                    authorColumn = f;
+                    header = true;
+                } else if (foldedFieldIs(name, "isbn")) {
+                    isbnColumn = f;
+                    header = true;
+                }
+            }
+            if (header) continue;
+        }
+
+        if (fieldCount == 1 && fields[0][0] == '\0') continue;  // Blank line
+        rows++;
+
+        if (titleColumn >= fieldCount || authorColumn >= fieldCount) {
+            skipped++;
+            continue;
+        }
+        char* title = trimField(fields[titleColumn]);
+        char* author = trimField(fields[authorColumn]);
+        char* isbn = (isbnColumn < fieldCount) ? trimField(fields[isbnColumn]) : "";
+        uint64_t key = 0;
+
+        if (title[0] == '\0'
+            || (isbn[0] != '\0' && (!parseISBN(isbn, &key) || isbnIndexFind(isbnIdx, key) >= 0))) {
+            skipped++;
+            continue;
+        }
+
+        int index = catalogAppend(cat, title, author);
+        if (isbn[0] != '\0') {
+            cat->isbns[index] = key;
+        } else {
+            key = isbnRangeGenerate(cat, &isbns, isbnIdx);
+            cat->isbns[index] = key;
+            generated++;
+        }
+        isbnIndexInsert(isbnIdx, key, index);
+    }
+    isbnReleaseRange(cat, &isbns);
+
+    fclose(reader.file);
+    free(reader.buffer);
+    double parsed = nowSeconds();
+
+    // Merge the whole import into the sorted indexes at once, then publish it
+    int added = cat->count - startCount;
+    catalogBeginIndexUpdate(cat);
+    sortedIndexInsertBatch(titleIdx, startCount, added);
+    sortedIndexInsertBatch(authorIdx, startCount, added);
+    catalogCommit(cat);
+    double finished = nowSeconds();
+
+    double elapsed = finished - started;
+    printf("%sImported %d of %d rows from %s (%d skipped, %d ISBNs generated).\n",
+           terminalColor(stdout, GREEN), added, rows, path, skipped, generated);
+    printf("Parse %.3f s, index %.3f s, total %.3f s: %.0f rows/s. Total books: %d\n%s",
+           parsed - started, finished - parsed, elapsed, elapsed > 0 ? rows / elapsed : 0.0, cat->count,
+           terminalColor(stdout, RESET));
+    return true;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @OUTPUT FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+bool fileIsTerminal(FILE* file)
+{
+#ifdef _WIN32
+    return _isatty(_fileno(file)) != 0;
+#else
+    return isatty(fileno(file)) != 0;
+#endif
+}
+
+// An ANSI color for printing to file, or "" when file is redirected
+const char* terminalColor(FILE* file, const char* color)
+{
+    return fileIsTerminal(file) ? color : "";
+}
+
+void outputInit(outputBuffer* out)
+{
+    out->data = allocOrExit(OUTPUT_BUFFER_SIZE);
+    out->length = 0;
+    out->capacity = OUTPUT_BUFFER_SIZE;
+    out->color = terminal.isTerminal;
+    out->grow = false;
+}
+
+// Write the buffered bytes straight to the stdout descriptor. stdio is
+// flushed first so earlier printf output still comes out in order.
+void outputFlush(outputBuffer* out)
+{
+    size_t written = 0;
+
+    fflush(stdout);
+    while (written < out->length) {
+#ifdef _WIN32
+        int n = _write(_fileno(stdout), out->data + written, (unsigned int)(out->length - written));
+#else
+        ssize_t n = write(fileno(stdout), out->data + written, out->length - written);
+#endif
+        if (n <= 0) break;  // Reader went away; drop the rest
+        written += (size_t)n;
+    }
+    out->length = 0;
+}
+
+void outputFree(outputBuffer* out)
+{
+    outputFlush(out);
+    free(out->data);
+    out->data = NULL;
+}
+
+static void outputBytes(outputBuffer* out, const char* text, size_t len)
+{
+    while (len > 0) {
+        if (out->length == out->capacity) {
+            if (out->grow) {
+                out->capacity *= 2;
+                out->data = reallocOrExit(out->data, out->capacity);
+            } else {
+                outputFlush(out);
+            }
+        }
+
+        size_t room = out->capacity - out->length;
+        size_t n = (len < room) ? len : room;
+        memcpy(out->data + out->length, text, n);
+        out->length += n;
+        text += n;
+        len -= n;
+    }
+}
+
+static void outputText(outputBuffer* out, const char* text)
+{
+    outputBytes(out, text, strlen(text));
+}
+
+// Color escapes are skipped entirely in plain mode
+static void outputColor(outputBuffer* out, const char* color)
+{
+    if (out->color) outputText(out, color);
+}
+
+static void outputInt(outputBuffer* out, long long value)
+{
+    char digits[24];
+    int pos = sizeof(digits);
+    bool negative = value < 0;
+    unsigned long long magnitude = negative ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+
+    do {
+        digits[--pos] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (negative) digits[--pos] = '-';
+
+    outputBytes(out, digits + pos, sizeof(digits) - (size_t)pos);
+}
+
+// One "~~> Label: value" line, label in cyan and value in `valueColor`
+static void outputField(outputBuffer* out, const char* label, const char* value, const char* valueColor)
+{
+    outputColor(out, CYAN);
+    outputText(out, label);
+    outputColor(out, valueColor);
+    outputText(out, value);
+    outputColor(out, RESET);
+    outputBytes(out, "\n", 1);
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @BATCH FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+// Make every change made by commands so far durable before their replies go
+// out: books added are flushed to the catalog file, then status changes are
+// group-committed to the log
+static void batchCommit(batchSession* session)
+{
+    catalogSyncAppends(session->cat);
+    walCommit(session->wal, session->cat);
+}
+
+// Merge books added by earlier batch commands into the sorted indexes.
+// Adds only touch the ISBN index, so a run of adds costs one merge.
+static void batchMergeAdds(catalog* cat, sortedIndex* titleIdx, sortedIndex* authorIdx)
+{
+    int first = (int)titleIdx->count;
+    if (first == cat->count) return;
+
+    uint64_t started = statsClock();
+    catalogBeginIndexUpdate(cat);
+    sortedIndexInsertBatch(titleIdx, first, cat->count - first);
+    sortedIndexInsertBatch(authorIdx, first, cat->count - first);
+    catalogCommit(cat);
+    statsRecord(STAT_MERGE, started);
+}
+
+// One result line: "book <isbn>\t<title>\t<author>\t<status>"
+static void batchBookLine(outputBuffer* out, const catalog* cat, int index)
+{
+    char isbn[ISBN_TEXT_SIZE];
+
+    formatISBN(cat->isbns[index], isbn);
+    outputText(out, "book ");
+    outputText(out, isbn);
+    outputBytes(out, "\t", 1);
+    outputText(out, cat->titles[index]);
+    outputBytes(out, "\t", 1);
+    outputText(out, cat->authors[index]);
+    outputText(out, catalogGetStatus(cat, index) == AVAILABLE ? "\tavailable\n" : "\tchecked-out\n");
+}
+
+static void batchReply(outputBuffer* out, const char* status, const char* detail)
+{
+    outputText(out, status);
+    if (detail != NULL) {
+        outputBytes(out, " ", 1);
+        outputText(out, detail);
+    }
+    outputBytes(out, "\n", 1);
+}
+
+// Look up the book named by an ISBN argument, replying with an error if
+// there is none
+static int batchFindBook(outputBuffer* out, const isbnIndex* isbnIdx, const char* arg)
+{
+    uint64_t isbn;
+
+    if (!parseISBN(arg, &isbn)) {
+        batchReply(out, "err", "invalid-isbn");
+        return -1;
+    }
+    uint64_t started = statsClock();
+    int index = isbnIndexFind(isbnIdx, isbn);
+    statsRecord(STAT_ISBN, started);
+    if (index < 0) batchReply(out, "err", "not-found");
+    return index;
+}
+
+// Split the field word off a "title <text>" or "author <text>" argument,
+// leaving args at the text. False if the word is neither.
+static bool batchSplitField(char** args, bool* byAuthor)
+{
+    char* text = *args;
+    size_t len = strcspn(text, " \t");
+
+    if (len == 5 && strncmp(text, "title", 5) == 0) {
+        *byAuthor = false;
+    } else if (len == 6 && strncmp(text, "author", 6) == 0) {
+        *byAuthor = true;
+    } else {
+        return false;
+    }
+
+    text += len;
+    while (*text == ' ') text++;
+    *args = text;
+    return true;
+}
+
+// Run one command line (without its newline) and append its reply to
+// out. Shared by batch mode and the server. Returns false for blank and
+// comment lines, which get no reply.
+static bool batchCommand(batchSession* session, char* line, outputBuffer* out)
+{
+    catalog* cat = session->cat;
+    walLog* wal = session->wal;
+    isbnIndex* isbnIdx = session->isbnIdx;
+    sortedIndex* titleIdx = session->titleIdx;
+    sortedIndex* authorIdx = session->authorIdx;
+    trigramIndex* titleGrams = session->titleGrams;
+    trigramIndex* authorGrams = session->authorGrams;
+    wordIndex* words = session->words;
+    size_t len = strlen(line);
+
+    if (len > 0 && line[len - 1] == '\r') line[--len] = '\0';
+    if (line[0] == '\0' || line[0] == '#') return false;
+
+    // Split off the command word; the rest are its arguments
+    char* args = line;
+    while (*args != '\0' && *args != ' ' && *args != '\t') args++;
+    if (*args != '\0') *args++ = '\0';
+    while (*args == ' ') args++;
+
+    if (strcmp(line, "add") == 0) {
+        char* fields[3] = {NULL, NULL, NULL};
+        int count = importSplitRow(args, '\t', fields, 3);
+        char* title = trimField(fields[0]);
+        char* author = (count > 1) ? trimField(fields[1]) : "";
+        uint64_t isbn = 0;
+
+        if (title[0] == '\0') {
+            batchReply(out, "err", "missing-title");
+        } else if (count > 2 && fields[2][0] != '\0' && !parseISBN(fields[2], &isbn)) {
+            batchReply(out, "err", "invalid-isbn");
+        } else if (isbn != 0 && isbnIndexFind(isbnIdx, isbn) >= 0) {
+            batchReply(out, "err", "duplicate-isbn");
+        } else {
+            char text[ISBN_TEXT_SIZE];
+            uint64_t started = statsClock();
+            int index = catalogAppend(cat, title, author);
+            if (isbn != 0) {
+                cat->isbns[index] = isbn;
+            } else {
+                isbn = generateISBN(cat, isbnIdx, index);
+            }
+            isbnIndexInsert(isbnIdx, isbn, index);
+            statsRecord(STAT_ADD, started);
+            formatISBN(isbn, text);
+            batchReply(out, "ok", text);
+        }
+    } else if (strcmp(line, "find") == 0) {
+        int index = batchFindBook(out, isbnIdx, args);
+        if (index >= 0) {
+            batchBookLine(out, cat, index);
+            batchReply(out, "ok", NULL);
+        }
+    } else if (strcmp(line, "checkout") == 0 || strcmp(line, "return") == 0) {
+        bool checkout = (line[0] == 'c');
+        int index = batchFindBook(out, isbnIdx, args);
+        if (index >= 0) {
+            if (catalogChangeStatus(cat, wal, index,
+                                    checkout ? AVAILABLE : CHECKED_OUT,
+                                    checkout ? CHECKED_OUT : AVAILABLE)) {
+                batchReply(out, "ok", NULL);
+            } else {
+                batchReply(out, "err", checkout ? "already-checked-out" : "already-available");
+            }
+        }
+    } else if (strcmp(line, "list") == 0) {
+        const sortedIndex* idx = NULL;
+        if (strncmp(args, "title", 5) == 0 || strncmp(args, "author", 6) == 0) {
+            idx = (args[0] == 't') ? titleIdx : authorIdx;
+            while (*args != '\0' && *args != ' ') args++;
+        }
+
+        char* end;
+        long offset = strtol(args, &end, 10);
+        long limit = strtol(end, NULL, 10);
+        if (offset < 0) offset = 0;
+        if (limit <= 0) limit = LONG_MAX;
+
+        // Results already queued must be durable before a long listing
+        // can push them out
+        batchCommit(session);
+        batchMergeAdds(cat, titleIdx, authorIdx);
+
+        catalogCursor cur;
+        indexRange rows = {0, (size_t)cat->count};
+        long listed = 0;
+        int index;
+        cursorOpen(&cur, idx, rows);
+        cursorSeek(&cur, (size_t)offset);
+        while (listed < limit && (index = cursorNext(&cur)) >= 0) {
+            batchBookLine(out, cat, index);
+            listed++;
+        }
+
+        char count[24];
+        snprintf(count, sizeof(count), "%ld", listed);
+        batchReply(out, "ok", count);
+    } else if (strcmp(line, "range") == 0) {
+        // Books whose title/author sorts between two bounds (inclusive), in
+        // index order
+        bool byAuthor = (strncmp(args, "author ", 7) == 0);
+        bool byTitle = (strncmp(args, "title ", 6) == 0);
+        char* fields[3] = {NULL, NULL, NULL};
+        int count = 0;
+        if (byAuthor || byTitle) {
+            count = importSplitRow(args + (byAuthor ? 7 : 6), '\t', fields, 3);
+        }
+
+        if (!byAuthor && !byTitle) {
+            batchReply(out, "err", "unknown-field");
+        } else if (count < 2) {
+            batchReply(out, "err", "missing-bound");
+        } else {
+            long limit = (count > 2) ? strtol(fields[2], NULL, 10) : 0;
+            if (limit <= 0) limit = LONG_MAX;
+
+            batchCommit(session);  // As for list: a long answer may push out queued results
+            batchMergeAdds(cat, titleIdx, authorIdx);
+
+            const sortedIndex* idx = byAuthor ? authorIdx : titleIdx;
+            foldedKey low, high;
+            foldKey(&low, trimField(fields[0]));
+            foldKey(&high, trimField(fields[1]));
+
+            catalogCursor cur;
+            long listed = 0;
+            int index;
+            cursorOpen(&cur, idx, sortedIndexBetween(idx, &low, &high));
+            while (listed < limit && (index = cursorNext(&cur)) >= 0) {
+                batchBookLine(out, cat, index);
+                listed++;
+            }
+
+            char counts[48];
+            snprintf(counts, sizeof(counts), "%ld %zu", listed, cursorCount(&cur));
+            batchReply(out, "ok", counts);
+        }
+    } else if (strcmp(line, "search") == 0 || strcmp(line, "fuzzy") == 0) {
+        // Books whose title/author contains the text (or, for fuzzy, comes
+        // within a few edits of it), best matches first
+        char* tab = strchr(args, '\t');
+        long limit = SEARCH_DEFAULT_LIMIT;
+        if (tab != NULL) {
+            *tab = '\0';
+            limit = strtol(tab + 1, NULL, 10);
+            if (limit < 0) limit = 0;  // 0 lists every match
+        }
+
+        char* text = args;
+        bool byAuthor;
+        if (!batchSplitField(&text, &byAuthor)) {
+            batchReply(out, "err", "unknown-field");
+        } else if (text[0] == '\0') {
+            batchReply(out, "err", "missing-text");  // Would match every book
+        } else {
+            foldedKey query;
+            searchResult res;
+            uint64_t started = statsClock();
+            foldKey(&query, text);
+            resultInit(&res, (size_t)limit);
+            if (line[0] == 'f') {
+                fuzzySearch(byAuthor ? authorGrams : titleGrams,
+                            byAuthor ? cat->authorKeys : cat->titleKeys, cat->count, &query, &res);
+            } else {
+                searchKeys(byAuthor ? cat->authorKeys : cat->titleKeys, cat->count, &query, &res);
+            }
+            resultFinish(&res);
+            statsRecord(line[0] == 'f' ? STAT_FUZZY : STAT_CONTAINS, started);  // search is a full contains scan
+
+            batchCommit(session);  // As for list: a long answer may push out queued results
+            for (size_t i = 0; i < res.count; i++) {
+                batchBookLine(out, cat, res.hits[i].position);
+            }
+
+            char counts[48];
+            snprintf(counts, sizeof(counts), "%zu %zu", res.count, res.total);
+            batchReply(out, "ok", counts);
+            resultFree(&res);
+        }
+    } else if (strcmp(line, "words") == 0) {
+        // Books whose title has all the words of one of the alternatives
+        char* tab = strchr(args, '\t');
+        long limit = SEARCH_DEFAULT_LIMIT;
+        if (tab != NULL) {
+            *tab = '\0';
+            limit = strtol(tab + 1, NULL, 10);
+            if (limit < 0) limit = 0;  // 0 lists every match
+        }
+
+        searchResult res;
+        uint64_t started = statsClock();
+        resultInit(&res, (size_t)limit);
+        wordSearch(words, cat->titleKeys, cat->count, args, &res);
+        resultFinish(&res);
+        statsRecord(STAT_WORDS, started);
+
+        batchCommit(session);  // As for list: a long answer may push out queued results
+        for (size_t i = 0; i < res.count; i++) {
+            batchBookLine(out, cat, res.hits[i].position);
+        }
+
+        char counts[48];
+        snprintf(counts, sizeof(counts), "%zu %zu", res.count, res.total);
+        batchReply(out, "ok", counts);
+        resultFree(&res);
+    } else if (strcmp(line, "stats") == 0) {
+        // Latency of every operation so far (microseconds) and the memory in
+        // use. Recording goes on meanwhile; nothing is locked or reset.
+        latencyHistogram* totals = allocOrExit(STAT_OPS * sizeof(latencyHistogram));
+        statsCollect(totals);
+        for (int op = 0; op < STAT_OPS; op++) {
+            const latencyHistogram* hist = &totals[op];
+            if (hist->count == 0) continue;
+
+            char text[160];
+            snprintf(text, sizeof(text), "stat %s %llu %.3f %.3f %.3f %.3f\n", statNames[op],
+                     (unsigned long long)hist->count, statsPercentile(hist, 0.50) / 1000.0,
+                     statsPercentile(hist, 0.90) / 1000.0, statsPercentile(hist, 0.99) / 1000.0,
+                     hist->max / 1000.0);
+            outputText(out, text);
+        }
+        free(totals);
+
+        memoryUsage memory = measureMemory(cat, isbnIdx, titleGrams, authorGrams, words);
+        char text[160];
+        snprintf(text, sizeof(text), "memory catalog %zu\nmemory isbn-index %zu\nmemory trigrams %zu\nmemory words %zu\n",
+                 memory.catalog, memory.isbnIndex, memory.trigrams, memory.words);
+        outputText(out, text);
+        batchReply(out, "ok", NULL);
+    } else if (strcmp(line, "checkedout") == 0) {
+        // Checked-out books, optionally only those whose title/author
+        // contains the text; no index covers this, so it is a parallel scan
+        char* tab = strchr(args, '\t');
+        long limit = SEARCH_DEFAULT_LIMIT;
+        if (tab != NULL) {
+            *tab = '\0';
+            limit = strtol(tab + 1, NULL, 10);
+            if (limit < 0) limit = 0;  // 0 lists every match
+        }
+
+        bool limitOnly = isdigit((unsigned char)args[0]);  // e.g. "checkedout\t0"
+        if (limitOnly) limit = strtol(args, NULL, 10);
+
+        char* text = args;
+        bool byAuthor = false;
+        bool byField = (args[0] != '\0' && !limitOnly);
+        if (byField && !batchSplitField(&text, &byAuthor)) {
+            batchReply(out, "err", "unknown-field");
+        } else {
+            foldedKey query;
+            searchResult res;
+            foldKey(&query, text);
+            resultInit(&res, (size_t)limit);
+            batchCommit(session);  // Report the statuses as logged
+            uint64_t started = statsClock();
+            searchCheckedOut(cat, byAuthor ? cat->authorKeys : cat->titleKeys,
+                             byField ? &query : NULL, &res);
+            resultFinish(&res);
+            statsRecord(STAT_CHECKEDOUT, started);
+
+            for (size_t i = 0; i < res.count; i++) {
+                batchBookLine(out, cat, res.hits[i].position);
+            }
+
+            char counts[48];
+            snprintf(counts, sizeof(counts), "%zu %zu", res.count, res.total);
+            batchReply(out, "ok", counts);
+            resultFree(&res);
+        }
+    } else {
+        batchReply(out, "err", "unknown-command");
+    }
+    return true;
+}
+
+// Run line-oriented commands from a file ("-" for stdin) without any
+// screen handling. Each command produces result lines ending in a line
+// that starts with "ok" or "err":
+//
+//   add <title>\t<author>[\t<isbn>]   ok <isbn>
+//   find <isbn>                       book ... / ok
+//   checkout <isbn>, return <isbn>    ok
+//   list [added|title|author] [offset [count]]   book ... / ok <rows>
+//   range title|author <from>\t<to>[\t<limit>]   book ... / ok <rows> <matches>
+//   search title|author <text>[\t<limit>]        book ... / ok <rows> <matches>
+//   fuzzy title|author <text>[\t<limit>]         book ... / ok <rows> <matches>
+//   words <word ...>[ | <word ...>][\t<limit>]    book ... / ok <rows> <matches>
+//   checkedout [title|author <text>][\t<limit>]  book ... / ok <rows> <matches>
+//   stats                             stat <op> <count> <p50> <p90> <p99> <max> ... / memory <part> <bytes> ... / ok
+//
+// Blank lines and lines starting with '#' are skipped. Added books and
+// status changes are committed every BATCH_GROUP_COMMANDS commands, and
+// results are only written out after the commit that made them durable.
+bool runBatch(batchSession* session, const char* path)
+{
+    FILE* in = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "Could not open command file %s.\n", path);
+        return false;
+    }
+
+    outputBuffer out;
+    outputInit(&out);
+    out.color = false;
+
+    bool flushEach = fileIsTerminal(in);  // Someone is typing: answer every line
+    char line[BATCH_LINE_SIZE];
+    long commands = 0;
+    int sinceCommit = 0;
+    double started = nowSeconds();
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        size_t len = strlen(line);
+        if (len > 0 && line[len - 1] == '\n') {
+            line[--len] = '\0';
+        } else if (!feof(in)) {
+            int c;
+            while ((c = fgetc(in)) != '\n' && c != EOF);
+            batchReply(&out, "err", "line-too-long");
+            continue;
+        }
+        if (!batchCommand(session, line, &out)) continue;
+        commands++;
+
+        // Group commit: one fsync covers every status change in the group,
+        // and no result leaves the process before its change is on disk
+        if (++sinceCommit >= BATCH_GROUP_COMMANDS || flushEach) {
+            batchCommit(session);
+            outputFlush(&out);
+            sinceCommit = 0;
+        }
+    }
+
+    batchCommit(session);
+    outputFree(&out);
+    batchMergeAdds(session->cat, session->titleIdx, session->authorIdx);
+    if (in != stdin) fclose(in);
+
+    double elapsed = nowSeconds() - started;
+    fprintf(stderr, "%ld commands in %.3f s (%.0f commands/s)\n",
+            commands, elapsed, elapsed > 0 ? commands / elapsed : 0.0);
+    return true;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @SERVER FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+#ifdef __linux__
+static volatile sig_atomic_t serverStopping = 0;
+
+static void serverStop(int signal)
+{
+    (void)signal;
+    serverStopping = 1;
+}
+
+// Listen on 127.0.0.1:<port> when the address is a number, otherwise on a
+// Unix socket at that path. Returns the non-blocking listening socket or -1.
+static int serverListen(const char* address)
+{
+    bool tcp = (address[0] != '\0' && strspn(address, "0123456789") == strlen(address));
+    int fd = socket(tcp ? AF_INET : AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    int bound;
+    if (tcp) {
+        struct sockaddr_in addr;
+        int reuse = 1;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)atoi(address));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        bound = bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    } else {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(address) >= sizeof(addr.sun_path)) {
+            close(fd);
+            return -1;
+        }
+        strcpy(addr.sun_path, address);
+        unlink(address);  // A socket file left by an earlier run
+        bound = bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    }
+
+    if (bound != 0 || listen(fd, SERVER_BACKLOG) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Watch a client for requests, or only for room to write while its replies
+// are backed up
+static void clientWatch(int epollFd, serverClient* client, bool writable)
+{
+    struct epoll_event event;
+
+    if (client->writable == writable) return;
+    client->writable = writable;
+    event.events = writable ? EPOLLOUT : EPOLLIN | EPOLLRDHUP;
+    event.data.ptr = client;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, client->fd, &event);
+}
+
+static void clientClose(serverClient** clients, serverClient* client)
+{
+    close(client->fd);  // Also removes it from the epoll set
+    if (client->prev != NULL) client->prev->next = client->next;
+    else *clients = client->next;
+    if (client->next != NULL) client->next->prev = client->prev;
+    free(client->out.data);
+    free(client);
+}
+
+// Run every complete line in the client's input buffer. Stops early while
+// the client has too many replies waiting, so a slow reader cannot make
+// the server buffer without limit.
+static long clientRun(batchSession* session, serverClient* client)
+{
+    long commands = 0;
+    size_t start = 0;
+
+    while (client->out.length - client->sent < CLIENT_OUTPUT_LIMIT) {
+        char* line = client->input + start;
+        char* newline = memchr(line, '\n', client->inputLength - start);
+        if (newline == NULL) break;
+
+        *newline = '\0';
+        start = (size_t)(newline - client->input) + 1;
+        if (client->discarding) {
+            client->discarding = false;  // End of the over-long line
+            continue;
+        }
+        if (batchCommand(session, line, &client->out)) commands++;
+    }
+
+    memmove(client->input, client->input + start, client->inputLength - start);
+    client->inputLength -= start;
+
+    // A full buffer without a newline holds a line longer than any command
+    if (client->inputLength == CLIENT_INPUT_SIZE && memchr(client->input, '\n', CLIENT_INPUT_SIZE) == NULL) {
+        if (!client->discarding) batchReply(&client->out, "err", "line-too-long");
+        client->discarding = true;
+        client->inputLength = 0;
+    }
+    return commands;
+}
+
+// Read whatever has arrived; returns false once the peer has closed or failed
+static bool clientRead(serverClient* client)
+{
+    while (client->inputLength < CLIENT_INPUT_SIZE) {
+        ssize_t n = recv(client->fd, client->input + client->inputLength,
+                         CLIENT_INPUT_SIZE - client->inputLength, 0);
+        if (n > 0) {
+            client->inputLength += (size_t)n;
+        } else if (n == 0) {
+            return false;
+        } else {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+    }
+    return true;
+}
+
+// Send queued replies until done or the socket is full; false on error
+static bool clientWrite(serverClient* client)
+{
+    while (client->sent < client->out.length) {
+        ssize_t n = send(client->fd, client->out.data + client->sent,
+                         client->out.length - client->sent, MSG_NOSIGNAL);
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        client->sent += (size_t)n;
+    }
+    client->out.length = 0;
+    client->sent = 0;
+    return true;
+}
+
+// Serve the batch command language to any number of desks at once from one
+// thread. Every loop iteration runs the requests that have arrived on all
+// ready sockets, then group-commits their check-outs and returns with one
+// fsync, and only then sends the replies, so no desk is ever told about a
+// change that is not yet on disk. Stops on SIGINT or SIGTERM.
+bool runServer(batchSession* session, const char* address)
+{
+    int listenFd = serverListen(address);
+    if (listenFd < 0) {
+        fprintf(stderr, "Could not listen on %s.\n", address);
+        return false;
+    }
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;  // NULL marks the listening socket
+    if (epollFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) != 0) {
+        fprintf(stderr, "Could not wait for connections on %s: %s.\n", address, strerror(errno));
+        if (epollFd >= 0) close(epollFd);
+        close(listenFd);
+        return false;
+    }
+
+    // A descriptor held in reserve: when the process runs out, it is freed
+    // to accept and at once close the waiting connection, which would
+    // otherwise keep the listener ready and the loop spinning
+    int spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    bool listening = true;
+
+    struct sigaction stop;
+    memset(&stop, 0, sizeof(stop));
+    stop.sa_handler = serverStop;  // No SA_RESTART, so epoll_wait returns
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+
+    serverClient* clients = NULL;
+    serverClient* ready[SERVER_MAX_EVENTS];
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    long commands = 0;
+    long accepted = 0;
+    double started = nowSeconds();
+
+    fprintf(stderr, "Serving %d books on %s (Ctrl+C to stop)\n", session->cat->count, address);
+    while (!serverStopping) {
+        // Listen again once a closed client has freed a descriptor
+        if (!listening && (spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC)) >= 0) {
+            listening = epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) == 0;
+        }
+
+        int count = epoll_wait(epollFd, events, SERVER_MAX_EVENTS, -1);
+        int readyCount = 0;
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Stopped waiting for requests: %s.\n", strerror(errno));
+            break;
+        }
+
+        for (int e = 0; e < count; e++) {
+            serverClient* client = events[e].data.ptr;
+
+            if (client == NULL) {
+                for (;;) {
+                    int fd = accept(listenFd, NULL, NULL);
+                    if (fd < 0 && (errno == EMFILE || errno == ENFILE)) {
+                        if (spareFd >= 0) {
+                            close(spareFd);
+                            fd = accept(listenFd, NULL, NULL);
+                            if (fd >= 0) close(fd);
+                            spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                            fprintf(stderr, "Out of file descriptors; refused a connection.\n");
+                        }
+                        if (spareFd < 0) {
+                            // No reserve left: stop watching the listener
+                            // until a client goes away
+                            epoll_ctl(epollFd, EPOLL_CTL_DEL, listenFd, NULL);
+                            listening = false;
+                            break;
+                        }
+                        if (fd >= 0) continue;
+                    }
+                    if (fd < 0) break;
+
+                    int noDelay = 1;
+                    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                    fcntl(fd, F_SETFD, FD_CLOEXEC);
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));  // Fails harmlessly on Unix sockets
+
+                    serverClient* added = allocOrExit(sizeof(serverClient));
+                    memset(added, 0, sizeof(*added));
+                    added->fd = fd;
+                    added->out.data = allocOrExit(CLIENT_OUTPUT_INITIAL);
+                    added->out.capacity = CLIENT_OUTPUT_INITIAL;
+                    added->out.grow = true;
+                    added->next = clients;
+                    if (clients != NULL) clients->prev = added;
+                    clients = added;
+
+                    struct epoll_event watch;
+                    watch.events = EPOLLIN | EPOLLRDHUP;
+                    watch.data.ptr = added;
+                    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &watch) != 0) {
+                        clientClose(&clients, added);  // Never polled, so it could never be served
+                        continue;
+                    }
+                    accepted++;
+                }
+                continue;
+            }
+
+            if (events[e].events & EPOLLIN) {
+                if (!clientRead(client)) client->closing = true;
+                commands += clientRun(session, client);
+            }
+            if (events[e].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) client->closing = true;
+            if (!client->pending) {
+                client->pending = true;
+                ready[readyCount++] = client;
+            }
+        }
+
+        // Group commit, then release the replies it made durable
+        batchCommit(session);
+        for (int r = 0; r < readyCount; r++) {
+            serverClient* client = ready[r];
+            client->pending = false;
+
+            bool ok = clientWrite(client);
+            // Replies sent: run the requests held back while they piled up
+            if (ok && client->inputLength > 0 && client->out.length == 0) {
+                commands += clientRun(session, client);
+                batchCommit(session);
+                ok = clientWrite(client);
+            }
+            if (!ok || (client->closing && client->out.length == 0)) {
+                clientClose(&clients, client);
+            } else {
+                clientWatch(epollFd, client, client->out.length > 0);
+            }
+        }
+    }
+
+    while (clients != NULL) {
+        clientWrite(clients);
+        clientClose(&clients, clients);
+    }
+    close(epollFd);
+    close(listenFd);
+    if (spareFd >= 0) close(spareFd);
+    if (strspn(address, "0123456789") != strlen(address)) unlink(address);
+
+    batchCommit(session);
+    batchMergeAdds(session->cat, session->titleIdx, session->authorIdx);
+
+    double elapsed = nowSeconds() - started;
+    fprintf(stderr, "\nServed %ld commands from %ld connections in %.3f s (%.0f commands/s)\n",
+            commands, accepted, elapsed, elapsed > 0 ? commands / elapsed : 0.0);
+    return true;
+}
+#else
+bool runServer(batchSession* session, const char* address)
+{
+    (void)session;
+    fprintf(stderr, "Server mode (%s) needs Linux; use --batch instead.\n", address);
+    return false;
+}
+#endif
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @STATISTICS FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+// Histogram counters have a single writer, so a relaxed load and store is
+// enough to add to them and a reader on another thread never sees a torn value
+static uint64_t statsRead(const uint64_t* counter)
+{
+#if defined(__GNUC__)
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+#else
+    return *(const volatile uint64_t*)counter;
+#endif
+}
+
+static void statsWrite(uint64_t* counter, uint64_t value)
+{
+#if defined(__GNUC__)
+    __atomic_store_n(counter, value, __ATOMIC_RELAXED);
+#else
+    *(volatile uint64_t*)counter = value;
+#endif
+}
+
+static int statsBucket(uint64_t nanos)
+{
+    if (nanos < 2 * STATS_SUB_BUCKETS) return (int)nanos;
+
+    int shift = highestBit64(nanos) - STATS_SUB_BITS;
+    return (shift + 1) * STATS_SUB_BUCKETS + (int)((nanos >> shift) & (STATS_SUB_BUCKETS - 1));
+}
+
+// Largest value that falls in a bucket
+static uint64_t statsBucketTop(int bucket)
+{
+    if (bucket < 2 * STATS_SUB_BUCKETS) return (uint64_t)bucket;
+
+    int shift = bucket / STATS_SUB_BUCKETS - 1;
+    uint64_t low = (uint64_t)(STATS_SUB_BUCKETS + bucket % STATS_SUB_BUCKETS) << shift;
+    return low + ((uint64_t)1 << shift) - 1;
+}
+
+// Give the calling thread its own histograms and list them for statsCollect.
+// Returns NULL once STATS_MAX_THREADS threads have registered.
+static threadStats* statsRegister(void)
+{
+#if defined(__GNUC__)
+    int slot = __atomic_fetch_add(&statsThreadCount, 1, __ATOMIC_ACQ_REL);
+#elif defined(_MSC_VER)
+    int slot = (int)InterlockedIncrement((volatile LONG*)&statsThreadCount) - 1;
+#else
+    int slot = statsThreadCount++;
+#endif
+    if (slot >= STATS_MAX_THREADS) return NULL;
+
+    threadStats* own = allocOrExit(sizeof(threadStats));
+    memset(own, 0, sizeof(*own));
+#if defined(__GNUC__)
+    __atomic_store_n(&statsThreads[slot], own, __ATOMIC_RELEASE);
+#else
+    statsThreads[slot] = own;
+#endif
+    statsOwn = own;
+    return own;
+}
+
+// Cheap timestamp for statsRecord: the CPU's time-stamp counter on x86,
+// which reads in a fraction of the time clock_gettime takes, otherwise
+// nanoseconds from the monotonic clock
+uint64_t statsClock(void)
+{
+#if KEY_SIMD
+    return __rdtsc();
+#else
+    return (uint64_t)(nowSeconds() * 1e9);
+#endif
+}
+
+// Measure how long a statsClock tick is against the monotonic clock, over
+// about two milliseconds
+void statsInit(void)
+{
+#if KEY_SIMD
+    double start = nowSeconds();
+    uint64_t ticks = statsClock();
+    double elapsed;
+    while ((elapsed = nowSeconds() - start) < 0.002);
+    uint64_t spent = statsClock() - ticks;
+    if (spent > 0) statsNanosPerTick = elapsed * 1e9 / (double)spent;
+#endif
+}
+
+// Time one operation, from `started` (a statsClock reading) until now
+void statsRecord(enum statOp op, uint64_t started)
+{
+    uint64_t ticks = statsClock() - started;
+    statsRecordNanos(op, (uint64_t)((double)ticks * statsNanosPerTick));
+}
+
+// Add one latency to the calling thread's histogram for op: a bucket index
+// and two counter updates
+void statsRecordNanos(enum statOp op, uint64_t nanos)
+{
+    threadStats* own = statsOwn;
+    if (own == NULL && (own = statsRegister()) == NULL) return;
+
+    latencyHistogram* hist = &own->ops[op];
+    uint64_t* counter = &hist->counts[statsBucket(nanos)];
+    statsWrite(counter, statsRead(counter) + 1);
+    if (nanos > statsRead(&hist->max)) statsWrite(&hist->max, nanos);
+}
+
+// Add up every thread's histograms into totals[STAT_OPS] while they keep
+// recording; a timing that lands during the copy may or may not be counted
+void statsCollect(latencyHistogram* totals)
+{
+    memset(totals, 0, STAT_OPS * sizeof(latencyHistogram));
+
+#if defined(__GNUC__)
+    int threads = __atomic_load_n(&statsThreadCount, __ATOMIC_ACQUIRE);
+#else
+    int threads = *(volatile int*)&statsThreadCount;
+#endif
+    if (threads > STATS_MAX_THREADS) threads = STATS_MAX_THREADS;
+
+    for (int t = 0; t < threads; t++) {
+#if defined(__GNUC__)
+        const threadStats* stats = __atomic_load_n(&statsThreads[t], __ATOMIC_ACQUIRE);
+#else
+        const threadStats* stats = *(threadStats* volatile*)&statsThreads[t];
+#endif
+        if (stats == NULL) continue;  // Registered but not published yet
+
+        for (int op = 0; op < STAT_OPS; op++) {
+            const latencyHistogram* hist = &stats->ops[op];
+            for (int b = 0; b < STATS_BUCKETS; b++) {
+                uint64_t n = statsRead(&hist->counts[b]);
+                totals[op].counts[b] += n;
+                totals[op].count += n;
+            }
+            uint64_t max = statsRead(&hist->max);
+            if (max > totals[op].max) totals[op].max = max;
+        }
+    }
+}
+
+// Latency at a quantile (0.5 for the median), as the top of the bucket it
+// falls in but never above the largest value seen. In nanoseconds.
+uint64_t statsPercentile(const latencyHistogram* hist, double quantile)
+{
+    if (hist->count == 0) return 0;
+
+    uint64_t rank = (uint64_t)(quantile * (double)(hist->count - 1)) + 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < STATS_BUCKETS; b++) {
+        seen += hist->counts[b];
+        if (seen >= rank) {
+            uint64_t top = statsBucketTop(b);
+            return (top < hist->max) ? top : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+static size_t trigramIndexMemory(const trigramIndex* idx)
+{
+    if (idx->buckets == NULL) return 0;
+
+    size_t bytes = TRIGRAM_BUCKETS * sizeof(trigramPostings) + (size_t)idx->sharedCapacity;
+    for (int b = 0; b < TRIGRAM_BUCKETS; b++) {
+        bytes += idx->buckets[b].capacity * sizeof(int);
+    }
+    return bytes;
+}
+
+static size_t wordIndexMemory(const wordIndex* idx)
+{
+    size_t bytes = idx->capacity * sizeof(int32_t) + idx->entryCapacity * sizeof(wordEntry) + idx->textCapacity;
+    for (size_t e = 0; e < idx->entryCount; e++) {
+        bytes += idx->entries[e].books.capacity + idx->entries[e].books.skipCapacity * sizeof(postingSkip);
+    }
+    return bytes;
+}
+
+// Measure what the catalog and its indexes hold right now. It only reads
+// sizes and list headers, never the books, so it is quick enough to answer
+// from the server loop.
+memoryUsage measureMemory(const catalog* cat, const isbnIndex* isbnIdx, const trigramIndex* titleGrams,
+                          const trigramIndex* authorGrams, const wordIndex* words)
+{
+    memoryUsage memory;
+
+    memory.catalog = 0;
+    if (cat->persistent) {
+        memory.catalog = cat->file.size;
+    } else {
+        for (int c = 0; c < COLUMN_COUNT; c++) memory.catalog += columnBytes(c, cat->capacity);
+    }
+    memory.isbnIndex = isbnIdx->capacity * sizeof(isbnSlot);
+    memory.trigrams = trigramIndexMemory(titleGrams) + trigramIndexMemory(authorGrams);
+    memory.words = wordIndexMemory(words);
+    return memory;
+}
+
+// Menu screen: latency of every operation done so far and the memory in use
+void displayStats(const memoryUsage* memory)
+{
+    latencyHistogram* totals = allocOrExit(STAT_OPS * sizeof(latencyHistogram));
+    statsCollect(totals);
+
+    printf(CYAN"\n<=======================================>\n"
+           "||              STATISTICS               ||\n"
+           "<=======================================>\n"RESET);
+    printf(YELLOW"%-11s %9s %9s %9s %9s %9s\n"RESET, "operation", "count", "p50 us", "p90 us", "p99 us", "max us");
+    for (int op = 0; op < STAT_OPS; op++) {
+        const latencyHistogram* hist = &totals[op];
+        if (hist->count == 0) continue;
+        printf(GREEN"%-11s"RESET" %9llu %9.2f %9.2f %9.2f %9.2f\n", statNames[op], (unsigned long long)hist->count,
+               statsPercentile(hist, 0.50) / 1000.0, statsPercentile(hist, 0.90) / 1000.0,
+               statsPercentile(hist, 0.99) / 1000.0, hist->max / 1000.0);
+    }
+
+    printf(CYAN"\nMemory: "GREEN"catalog %.1f MB, ISBN index %.1f MB, trigram index %.1f MB, word index %.1f MB\n"RESET,
+           memory->catalog / 1048576.0, memory->isbnIndex / 1048576.0,
+           memory->trigrams / 1048576.0, memory->words / 1048576.0);
+    free(totals);
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @BENCHMARK FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+// Time the array catalog on a synthetic library: adding books in batches,
+// ISBN lookups, exact title searches, desk check-outs/returns and full
+// listings. The catalog lives on the heap, so nothing touches library.dat.
+// Returns false if a lookup did not find the book it was looking for.
+bool runBench(const benchConfig* config)
+{
+    catalog cat;
+    isbnIndex isbnIdx;
+    sortedIndex titleIdx;
+    sortedIndex authorIdx;
+    walLog wal;
+    zipfTable words;
+    zipfTable authors;
+    zipfTable books;
+    benchPhase phase;
+    outputBuffer out;
+    uint64_t state = config->seed;
+    int n = config->books;
+    bool found = true;
+
+    catalogInit(&cat, CATALOG_INITIAL_CAPACITY);
+    isbnIndexInit(&isbnIdx);
+    sortedIndexInit(&titleIdx, &cat.titleOrder, &cat.titleKeys);
+    sortedIndexInit(&authorIdx, &cat.authorOrder, &cat.authorKeys);
+    memset(&wal, 0, sizeof(wal));  // No log file, so status changes are not logged
+    initContainsKernel();
+    zipfInit(&words, BENCH_VOCABULARY, config->zipf);
+    zipfInit(&authors, (n + BENCH_BOOKS_PER_AUTHOR - 1) / BENCH_BOOKS_PER_AUTHOR, config->zipf);
+    benchHeader("array", config);
+
+    // Each batch is generated untimed, then added and merged into the
+    // sorted indexes as the batch "add" command does
+    char (*titles)[50] = allocOrExit(BENCH_INSERT_BATCH * sizeof(*titles));
+    char (*names)[50] = allocOrExit(BENCH_INSERT_BATCH * sizeof(*names));
+    phaseInit(&phase);
+    for (int done = 0; done < n; done += BENCH_INSERT_BATCH) {
+        int batch = (n - done < BENCH_INSERT_BATCH) ? n - done : BENCH_INSERT_BATCH;
+        for (int i = 0; i < batch; i++) {
+            benchTitle(titles[i], sizeof(titles[i]), &words, &state);
+            benchAuthor(names[i], sizeof(names[i]), zipfNext(&authors, &state));
+        }
+
+        double started = nowSeconds();
+        for (int i = 0; i < batch; i++) {
+            int index = catalogAppend(&cat, titles[i], names[i]);
+            isbnIndexInsert(&isbnIdx, generateISBN(&cat, &isbnIdx, index), index);
+        }
+        batchMergeAdds(&cat, &titleIdx, &authorIdx);
+        phaseRecord(&phase, nowSeconds() - started, batch);
+    }
+    phaseReport(&phase, "insert");
+    free(titles);
+    free(names);
+
+    zipfInit(&books, n, config->zipf);
+    int* popular = benchPermutation(n, &state);  // Position of the book with each popularity rank
+
+    // Lookups are timed BENCH_TIMED_OPS at a time on books drawn beforehand
+    int targets[BENCH_TIMED_OPS];
+    uint64_t isbns[BENCH_TIMED_OPS];
+    int results[BENCH_TIMED_OPS];
+    phaseInit(&phase);
+    for (int q = 0; q < BENCH_QUERIES; q += BENCH_TIMED_OPS) {
+        for (int i = 0; i < BENCH_TIMED_OPS; i++) {
+            targets[i] = popular[zipfNext(&books, &state)];
+            isbns[i] = cat.isbns[targets[i]];
+        }
+
+        double started = nowSeconds();
+        for (int i = 0; i < BENCH_TIMED_OPS; i++) {
+            results[i] = isbnIndexFind(&isbnIdx, isbns[i]);
+        }
+        phaseRecord(&phase, nowSeconds() - started, BENCH_TIMED_OPS);
+        for (int i = 0; i < BENCH_TIMED_OPS; i++) {
+            if (results[i] != targets[i]) found = false;
+        }
+    }
+    phaseReport(&phase, "isbn lookup");
+
+    char (*queries)[50] = allocOrExit(BENCH_TIMED_OPS * sizeof(*queries));
+    phaseInit(&phase);
+    for (int q = 0; q < BENCH_QUERIES; q += BENCH_TIMED_OPS) {
+        for (int i = 0; i < BENCH_TIMED_OPS; i++) {
+            memcpy(queries[i], cat.titles[popular[zipfNext(&books, &state)]], sizeof(queries[i]));
+        }
+
+        double started = nowSeconds();
+        for (int i = 0; i < BENCH_TIMED_OPS; i++) {
+            foldedKey key;
+            searchResult res;
+            foldKey(&key, queries[i]);
+            resultInit(&res, SEARCH_DEFAULT_LIMIT);
+            searchRange(&titleIdx, sortedIndexExact(&titleIdx, &key), &key, &res);
+            resultFinish(&res);
+            results[i] = (int)res.total;
+            resultFree(&res);
+        }
+        phaseRecord(&phase, nowSeconds() - started, BENCH_TIMED_OPS);
+        for (int i = 0; i < BENCH_TIMED_OPS; i++) {
+            if (results[i] == 0) found = false;
+        }
+    }
+    phaseReport(&phase, "title search");
+    free(queries);
+
+    // A desk action: find the book by ISBN, then change its status. Each
+    // drawn book is checked out and returned, so both always succeed.
+    phaseInit(&phase);
+    for (int q = 0; q < BENCH_QUERIES; q += BENCH_TIMED_OPS) {
+        for (int i = 0; i < BENCH_TIMED_OPS / 2; i++) {
+            isbns[i] = cat.isbns[popular[zipfNext(&books, &state)]];
+        }
+
+        double started = nowSeconds();
+        for (int i = 0; i < BENCH_TIMED_OPS / 2; i++) {
+            int index = isbnIndexFind(&isbnIdx, isbns[i]);
+            results[2 * i] = index >= 0 && catalogChangeStatus(&cat, &wal, index, AVAILABLE, CHECKED_OUT);
+            index = isbnIndexFind(&isbnIdx, isbns[i]);
+            results[2 * i + 1] = index >= 0 && catalogChangeStatus(&cat, &wal, index, CHECKED_OUT, AVAILABLE);
+        }
+        phaseRecord(&phase, nowSeconds() - started, BENCH_TIMED_OPS);
+        for (int i = 0; i < BENCH_TIMED_OPS; i++) {
+            if (!results[i]) found = false;
+        }
+    }
+    phaseReport(&phase, "checkout/return");
+
+    // Listings render every book line as batch "list" does; the text is
+    // thrown away, so only reading and formatting the catalog is timed
+    outputInit(&out);
+    out.color = false;
+    for (int order = 0; order < 2; order++) {
+        phaseInit(&phase);
+        for (int pass = 0; pass < BENCH_LIST_PASSES; pass++) {
+            for (int row = 0; row < cat.count; row += BENCH_TIMED_OPS) {
+                int end = (cat.count - row < BENCH_TIMED_OPS) ? cat.count : row + BENCH_TIMED_OPS;
+
+                double started = nowSeconds();
+                for (int r = row; r < end; r++) {
+                    batchBookLine(&out, &cat, order == 0 ? r : cat.titleOrder[r]);
+                }
+                phaseRecord(&phase, nowSeconds() - started, end - row);
+                if (out.length > OUTPUT_BUFFER_SIZE / 2) out.length = 0;
+            }
+            out.length = 0;
+        }
+        phaseReport(&phase, order == 0 ? "list added" : "list title");
+    }
+    outputFree(&out);
+
+    if (!found) printf(RED"Some lookups did not find their book.\n"RESET);
+    free(popular);
+    zipfFree(&books);
+    zipfFree(&authors);
+    zipfFree(&words);
+    isbnIndexFree(&isbnIdx);
+    catalogFree(&cat);
+    return found;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @DISPLAY FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+// Render one book of a listing as it appears in displayAll
+static void renderBook(outputBuffer* out, const catalog* cat, int index, size_t number)
+{
+    char isbn[ISBN_TEXT_SIZE];
+    bool available = catalogGetStatus(cat, index) == AVAILABLE;
+
+    formatISBN(cat->isbns[index], isbn);
+    outputColor(out, YELLOW);
+    outputText(out, "<=======================================>\n");
+    outputColor(out, CYAN);
+    outputText(out, "~~> Book #");
+    outputInt(out, (long long)number);
+    outputBytes(out, "\n", 1);
+    outputColor(out, RESET);
+    outputField(out, "~~> Title: ", cat->titles[index], GREEN);
+    outputField(out, "~~> Author:  ", cat->authors[index], GREEN);
+    outputField(out, "~~> ISBN: ", isbn, GREEN);
+    outputField(out, "~~> AVAILABILITY: ", available ? "Available" : "Checked Out", available ? GREEN : RED);
+}
+
+// List every book. Records are rendered into an output buffer and written
+// in large blocks, without colors when stdout is redirected.
+void displayAll(const catalog* cat) {
+    outputBuffer out;
+
+    outputInit(&out);
+    outputColor(&out, CYAN);
+    outputText(&out, "\n<=======================================>\n"
+                     "||              ALL BOOKS                 ||\n"
+                     "<=======================================>\n\n");
+    outputColor(&out, RESET);
+
+    for (int i = 0; i < cat->count; i++) {
+        renderBook(&out, cat, i, (size_t)i + 1);
+    }
+
+    int checkedOut = catalogCountCheckedOut(cat);
+    outputColor(&out, YELLOW);
+    outputText(&out, "<=======================================>\n");
+    outputColor(&out, CYAN);
+    outputText(&out, "~~> Total: ");
+    outputInt(&out, cat->count);
+    outputText(&out, " | Available: ");
+    outputInt(&out, cat->count - checkedOut);
+    outputText(&out, " | Checked Out: ");
+    outputInt(&out, checkedOut);
+    outputBytes(&out, "\n", 1);
+    outputColor(&out, RESET);
+    outputFree(&out);
+}
+
+// Show one page of a listing: `pageSize` rows starting `offset` rows in.
+// The cursor seeks straight to the page, so only its rows are touched.
+static void displayPage(const catalog* cat, catalogCursor* cur, size_t offset, size_t pageSize, const char* orderName)
+{
+    outputBuffer out;
+    size_t total = cursorCount(cur);
+    size_t shown = 0;
+    int index;
+
+    outputInit(&out);
+    outputColor(&out, CYAN);
+    outputText(&out, "\n<=======================================>\n"
+                     "||              ALL BOOKS                 ||\n"
+                     "<=======================================>\n");
+    outputText(&out, "~~> Books ");
+    outputInt(&out, (long long)offset + 1);
+    outputText(&out, "-");
+    outputInt(&out, (long long)(offset + pageSize < total ? offset + pageSize : total));
+    outputText(&out, " of ");
+    outputInt(&out, (long long)total);
+    outputText(&out, ", by ");
+    outputText(&out, orderName);
+    outputText(&out, " (page ");
+    outputInt(&out, (long long)(offset / pageSize + 1));
+    outputText(&out, " of ");
+    outputInt(&out, (long long)((total + pageSize - 1) / pageSize));
+    outputText(&out, ")\n\n");
+    outputColor(&out, RESET);
+
+    cursorSeek(cur, offset);
+    while (shown < pageSize && (index = cursorNext(cur)) >= 0) {
+        renderBook(&out, cat, index, offset + shown + 1);
+        shown++;
+    }
+
+    outputColor(&out, YELLOW);
+    outputText(&out, "<=======================================>\n");
+    outputColor(&out, RESET);
+    outputFree(&out);
+}
+
+// Page through the catalog in the order books were added, or by title or
+// author through the sorted indexes
+void browseCatalog(const catalog* cat, const sortedIndex* titleIdx, const sortedIndex* authorIdx)
+{
+    const sortedIndex* orders[] = {NULL, titleIdx, authorIdx};
+    const char* orderNames[] = {"date added", "title", "author"};
+    int order = 0;
+    size_t pageSize = PAGE_SIZE_DEFAULT;
+    size_t offset = 0;
+    char line[64];
+
+    while (true) {
+        catalogCursor cur;
+        indexRange rows = {0, (size_t)cat->count};
+        cursorOpen(&cur, orders[order], rows);
+
+        // Keep the offset on a page boundary inside the listing
+        size_t lastPage = ((cursorCount(&cur) - 1) / pageSize) * pageSize;
+        if (offset > lastPage) offset = lastPage;
+        offset -= offset % pageSize;
+
+        clearScreen();
+        displayHeader();
+        displayPage(cat, &cur, offset, pageSize, orderNames[order]);
+        printf(YELLOW"~~ n - Next\tp - Previous\tg N - Go to book #N\n"
+               "~~ o - Order (date added/title/author)\ts N - Books per page\n"
+               "~~ a - Print all\tq - Back to menu\n|=> "RESET);
+
+        if (fgets(line, sizeof(line), stdin) == NULL) return;
+        if (strchr(line, '\n') == NULL) {
+            int c;
+            while ((c = getchar()) != '\n' && c != EOF);  // Drop the rest of a long line
+        }
+
+        long value = strtol(line + 1, NULL, 10);
+        switch (tolower((unsigned char)line[0])) {
+            case 'n':
+                offset += pageSize;
+                break;
+            case 'p':
+                offset = (offset >= pageSize) ? offset - pageSize : 0;
+                break;
+            case 'g':
+                if (value >= 1) offset = (size_t)(value - 1);
+                break;
+            case 'o':
+                order = (order + 1) % 3;
+                offset = 0;
+                break;
+            case 's':
+                if (value >= 1 && value <= PAGE_SIZE_MAX) pageSize = (size_t)value;
+                break;
+            case 'a':
+                clearScreen();
+                displayHeader();
+                displayAll(cat);
+                waitForKeypress();
+                break;
+            case 'q':
+                return;
+            default:
+                break;
+        }
+    }
+}
+
+void displaySingle(const catalog* cat, int index) {
+    printf(YELLOW"\n<=======================================>\n"
+           "||              BOOK DETAILS              ||\n"
+           "<=======================================>\n\n"RESET);
+    
+    char isbn[ISBN_TEXT_SIZE];
+    formatISBN(cat->isbns[index], isbn);
+
+    printf(CYAN"~~> Title: "RESET);
+    printf(GREEN"%s\n"RESET, cat->titles[index]);
+    printf(CYAN"~~> Author: "RESET);
+    printf(GREEN"%s\n"RESET, cat->authors[index]);
+    printf(CYAN"~~> ISBN: "RESET);
+    printf(GREEN"%s\n"RESET, isbn);
+    printf(CYAN"~~> AVAILABILITY: "RESET);
+    printf("%s\n", catalogGetStatus(cat, index) == AVAILABLE ? GREEN"Available"RESET : RED"Checked Out"RESET);
+    
+    printf(YELLOW"<=======================================>\n"RESET);
+}
+
+char* getAvailability(enum bookStatus status)
+{
+    switch(status)
+    {
+        case AVAILABLE:
+            return "Available";
+        case CHECKED_OUT:
+            return "Checked Out";
+        default:
+            return "Unknown";  // Add default case for better error handling
+    }
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     @CHECKOUT/RETURN FUNCTIONS
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
-void returnBook(book* books, int index) 
+// Move a book from status `from` to `to` and queue the change in the log.
+// Returns false, changing nothing, if the book is not in status `from`.
+// The test and the change are one compare-and-swap, so of two desks racing
+// for the same copy exactly one succeeds and only that one is logged.
+bool catalogChangeStatus(catalog* cat, walLog* wal, int index, enum bookStatus from, enum bookStatus to)
+{
+    uint64_t started = statsClock();
+    bool changed = catalogTransitionStatus(cat, index, from, to);
+    if (changed) walAppend(wal, cat, index, from, to);
+    statsRecord(to == CHECKED_OUT ? STAT_CHECKOUT : STAT_RETURN, started);
+    return changed;
+}
+
+void returnBook(catalog* cat, walLog* wal, int index) 
 {
-    if (books[index].status == CHECKED_OUT) {
-        books[index].status = AVAILABLE;
+    if (catalogChangeStatus(cat, wal, index, CHECKED_OUT, AVAILABLE)) {
         printf(GREEN"\nBook has been returned successfully.\n"RESET);
     } else {
         printf(YELLOW"\nBook is already available.\n"RESET);
     }
 }
 
-void checkOutBook(book* books, int index) 
+void checkOutBook(catalog* cat, walLog* wal, int index) 
 {
-    if (books[index].status == AVAILABLE) {
-        books[index].status = CHECKED_OUT;
+    if (catalogChangeStatus(cat, wal, index, AVAILABLE, CHECKED_OUT)) {
         printf(GREEN"\nBook has been checked out successfully.\n"RESET);
     } else {
         printf(RED"\nBook is already checked out.\n"RESET);
@@ -6,7 +6,16 @@
 #include <time.h>
 #include <string.h>
 #include <stdlib.h>
-#include <windows.h> // Added for Windows-specific functions
+#include <stdint.h>
+#include <stddef.h>
+#include <ctype.h>
+#ifdef _WIN32
+#include <windows.h> // Sleep, performance counter and console API
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "library_bench.h" // --bench workload, shared with hackathon_improved.c
 
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     @MACROS
@@ -22,48 +31,229 @@
 // Enum for status types
 enum bookStatus {AVAILABLE = 1, CHECKED_OUT = 0};
 
+// Lower-cased copy of a searchable field, built once when the book is stored
+typedef struct FoldedKey {
+    uint32_t hash;     // FNV-1a hash of the folded bytes
+    uint8_t length;    // Number of folded bytes, excluding the terminator
+    char text[50];     // Folded field, NUL-terminated
+} foldedKey;
+
 // Declare book data structure as 'book'
 typedef struct Book {
     char title[50];
     char author[50];
-    char isbn[20];
-    enum bookStatus status;
-    struct Book* next;  // Pointer to the next book in the linked list
+    uint64_t isbn;        // ISBN-13 as a 13-digit integer, formatted only for display
+    int32_t status;       // enum bookStatus; read with bookGetStatus, changed with bookChangeStatus
+    foldedKey titleKey;   // Search key for title, kept in sync by store
+    foldedKey authorKey;  // Search key for author, kept in sync by store
 } book;
 
+#define BOOKS_PER_CHUNK 4096
+
+// Fixed-size block of books; chunks are linked so capacity stays unlimited
+typedef struct BookChunk {
+    book books[BOOKS_PER_CHUNK];
+    int used;                  // Number of filled slots in this chunk
+    struct BookChunk* next;    // Pointer to the next chunk in the list
+} bookChunk;
+
+// Arena that owns every book. Books never move once added, so book pointers
+// stay valid as handles for the indexes and for checkout/return.
+typedef struct BookArena {
+    bookChunk* first;
+    bookChunk* last;           // Chunk that new books are appended to
+    bookChunk** chunks;        // Every chunk in order, so book #N is found without walking the list
+    int chunkCount;
+    int chunkCapacity;
+    int count;
+    uint64_t isbnSequence;     // Next sequence number for generateISBN
+} bookArena;
+
+#define ISBN_INDEX_INITIAL_CAPACITY 256 // Must be a power of two
+
+#define ISBN_TEXT_SIZE 16               // "979-123456789-7" and the terminator
+#define ISBN_INPUT_SIZE 32              // Typed ISBN, with room for hyphens and spaces
+#define ISBN_GENERATED_PREFIX 979ULL    // Generated ISBNs are 979, 9 digits, check digit
+#define ISBN_BODY_SPACE 1000000000u     // Values of the 9 digits after the prefix
+#define ISBN_SCRAMBLE_HALF_BITS 15      // Scramble works on 30 bits, just above ISBN_BODY_SPACE
+#define ISBN_SCRAMBLE_ROUNDS 4
+#define ISBN_SCRAMBLE_KEY 0x9e3779b97f4a7c15ULL
+
+#define OUTPUT_BUFFER_SIZE (1 << 20) // Bytes rendered before each write to stdout
+
+// Render buffer for long listings: records are formatted into `data` and
+// written to stdout with one write per full buffer instead of one printf
+// per field
+typedef struct OutputBuffer {
+    char* data;
+    size_t length;
+    bool color;              // Emit ANSI colors; off when stdout is not a terminal
+} outputBuffer;
+
+// Open-addressing hash index slot keyed on the ISBN-13
+typedef struct IsbnSlot {
+    uint64_t key;    // ISBN-13 as an integer
+    book* node;      // Book stored under this key, NULL if slot is empty
+} isbnSlot;
+
+// Hash index used for O(1) ISBN lookups at the checkout desk
+typedef struct IsbnIndex {
+    isbnSlot* slots;
+    size_t capacity; // Always a power of two
+    size_t count;
+} isbnIndex;
+
+// Sorted secondary index over one text field, compared case-insensitively
+typedef struct SortedIndex {
+    book** order;        // Book nodes ordered by folded key, oldest first on ties
+    size_t count;
+    size_t capacity;
+    size_t keyOffset;    // offsetof(book, titleKey) or offsetof(book, authorKey)
+} sortedIndex;
+
+// Half-open range [first, last) of positions inside a sorted index
+typedef struct IndexRange {
+    size_t first;
+    size_t last;
+} indexRange;
+
+#define PAGE_SIZE_DEFAULT 10  // Books per page when browsing the catalog
+#define PAGE_SIZE_MAX 1000
+
+// Cursor over the rows of one listing: the books in the order they were
+// added, or the books in the order of a sorted index. It hands out one book
+// at a time, so callers never walk rows they do not show.
+typedef struct BookCursor {
+    const bookArena* arena;
+    const sortedIndex* idx;  // NULL walks books in the order they were added
+    size_t first;            // Rows [first, last) of the listing
+    size_t last;
+    size_t position;         // Next row to return
+} bookCursor;
+
+// One search match: the book and how well it matched
+typedef struct SearchHit {
+    book* node;
+    size_t row;        // Position in the sorted index, breaks ties oldest first
+    uint32_t score;    // Higher is better; see matchScore
+} searchHit;
+
+// The best matches of one search. While the index is scanned the hits form
+// a min-heap with the weakest kept match on top, so a top-K search keeps K
+// handles no matter how many books match; resultFinish sorts them best
+// first. Only book pointers are stored, never copies of the books.
+typedef struct SearchResult {
+    searchHit* hits;
+    size_t count;      // Hits kept
+    size_t capacity;
+    size_t limit;      // Keep at most this many; 0 keeps every match
+    size_t total;      // Every match seen, kept or not
+} searchResult;
+
+#define SEARCH_DEFAULT_LIMIT 20  // Matches listed by an interactive search
+
+// What the console on stdout can do, detected once by terminalInit
+typedef struct TerminalInfo {
+    bool isTerminal;  // stdout is a console rather than a file or pipe
+    bool ansi;        // The console understands ANSI escape sequences
+} terminalInfo;
+
+// Cosmetic pause after an interactive search, in milliseconds; 0 turns it
+// off. Set with --search-delay; batch mode never pauses.
+static int searchDelayMs = 0;
+
+// Console capabilities, filled in at startup
+static terminalInfo terminal = {false, false};
+
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     @FUNCTION PROTOTYPES
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
 int search ();
-void store (book** head, int* bookCount);
-void displayAll (book* head, int bookCount);
+void store (bookArena* arena, isbnIndex* isbnIdx, sortedIndex* titleIdx, sortedIndex* authorIdx);
+void displayAll (const bookArena* arena);
+void browseCatalog (const bookArena* arena, const sortedIndex* titleIdx, const sortedIndex* authorIdx);
 void displaySingle (book* node);
 void returnBook (book* node);
 void checkOutBook (book* node);
-book* searchByTitle (book* head, int bookCount);
-book* searchByAuthor (book* head, int bookCount);
-book* searchByISBN (book* head, int bookCount);
+book* searchByTitle (sortedIndex* titleIdx);
+book* searchByAuthor (sortedIndex* authorIdx);
+book* searchByISBN (isbnIndex* isbnIdx);
 char* getAvailability(enum bookStatus status);
-void generateISBN(book* node);
+enum bookStatus bookGetStatus(const book* node);
+bool bookChangeStatus(book* node, enum bookStatus from, enum bookStatus to);
+uint64_t generateISBN(bookArena* arena, const isbnIndex* isbnIdx, book* node);
 void clearScreen();
 void displayHeader();
 void displayMainMenu();
 void waitForKeypress();
-book* createNewBook();
-void freeAllBooks(book** head);
+double nowSeconds(void);
+void pauseMs(int ms);
+double searchStarted(void);
+void searchFinished(double started);
+bool fileIsTerminal(FILE* file);
+void terminalInit(void);
+void outputInit(outputBuffer* out);
+void outputFlush(outputBuffer* out);
+void outputFree(outputBuffer* out);
+void arenaInit(bookArena* arena);
+book* createNewBook(bookArena* arena);
+book* arenaBook(const bookArena* arena, size_t position);
+void freeAllBooks(bookArena* arena);
+void isbnIndexInit(isbnIndex* idx);
+void isbnIndexFree(isbnIndex* idx);
+bool isbnIndexInsert(isbnIndex* idx, uint64_t key, book* node);
+book* isbnIndexFind(const isbnIndex* idx, uint64_t key);
+bool parseISBN(const char* text, uint64_t* isbn);
+uint64_t isbnScramble(uint64_t sequence);
+void formatISBN(uint64_t isbn, char* out);
+void foldKey(foldedKey* key, const char* text);
+void sortedIndexInit(sortedIndex* idx, size_t keyOffset);
+void sortedIndexFree(sortedIndex* idx);
+void sortedIndexInsertBatch(sortedIndex* idx, book** batch, int count);
+indexRange sortedIndexExact(const sortedIndex* idx, const foldedKey* key);
+indexRange sortedIndexPrefix(const sortedIndex* idx, const foldedKey* prefix);
+void cursorOpen(bookCursor* cur, const bookArena* arena, const sortedIndex* idx, indexRange range);
+bool cursorSeek(bookCursor* cur, size_t offset);
+size_t cursorCount(const bookCursor* cur);
+book* cursorNext(bookCursor* cur);
+uint32_t matchScore(const foldedKey* key, const foldedKey* query);
+void resultInit(searchResult* res, size_t limit);
+void resultOffer(searchResult* res, book* node, size_t row, uint32_t score);
+void resultFinish(searchResult* res);
+void resultFree(searchResult* res);
+void searchRange(const sortedIndex* idx, indexRange range, const foldedKey* query, searchResult* res);
+bool runBench(const benchConfig* config);
 // void typewriter(const char *text, int delay_ms);
 
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     @MAIN FUNCTION
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
-int main ()
+int main (int argc, char* argv[])
 {
-    // Declare head of the linked list
-    book* head = NULL;
+    // Declare the arena that owns every book
+    bookArena arena;
+    isbnIndex isbnIdx;
+    sortedIndex titleIdx;
+    sortedIndex authorIdx;
+
+    // Usage: library [--search-delay MS]
+    //        library --bench BOOKS [--zipf S] [--seed N]
+    benchConfig bench = {0, BENCH_DEFAULT_ZIPF, 1};  // --bench runs instead of the menu
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--search-delay") == 0) searchDelayMs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--bench") == 0) bench.books = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--zipf") == 0) bench.zipf = strtod(argv[++i], NULL);
+        else if (strcmp(argv[i], "--seed") == 0) bench.seed = strtoull(argv[++i], NULL, 10);
+    }
 
-    int bookCount = 0;
+    terminalInit();
+    if (bench.books > 0) return runBench(&bench) ? 0 : 1;
+    arenaInit(&arena);
+    isbnIndexInit(&isbnIdx);
+    sortedIndexInit(&titleIdx, offsetof(book, titleKey));
+    sortedIndexInit(&authorIdx, offsetof(book, authorKey));
     int usrChoice;
 
     // Main menu loop
@@ -81,23 +271,23 @@ int main ()
             case '1':
                clearScreen();
                displayHeader();
-               store(&head, &bookCount);
+               store(&arena, &isbnIdx, &titleIdx, &authorIdx);
                waitForKeypress();
                break;
             case '2':
                 clearScreen();
                 displayHeader();
-                if (bookCount > 0) {
-                    displayAll(head, bookCount);
+                if (arena.count > 0) {
+                    browseCatalog(&arena, &titleIdx, &authorIdx);
                 } else {
                     printf(RED"\nNo books to display.\n"RESET);
+                    waitForKeypress();
                 }
-                waitForKeypress();
                 break;
             case '3':
                 clearScreen();
                 displayHeader();
-                if (bookCount <= 0) {
+                if (arena.count <= 0) {
                     printf(RED"\nNo books to search.\n"RESET);
                     waitForKeypress();
                     break;
@@ -116,19 +306,19 @@ int main ()
                     case '1':
                         clearScreen();
                         displayHeader();
-                        foundBook = searchByTitle(head, bookCount);
+                        foundBook = searchByTitle(&titleIdx);
                         if (foundBook != NULL) displaySingle(foundBook);
                         break;
                     case '2':
                         clearScreen();
                         displayHeader();
-                        foundBook = searchByAuthor(head, bookCount);
+                        foundBook = searchByAuthor(&authorIdx);
                         if (foundBook != NULL) displaySingle(foundBook);
                         break;
                     case '3': 
                         clearScreen();
                         displayHeader();
-                        foundBook = searchByISBN(head, bookCount);
+                        foundBook = searchByISBN(&isbnIdx);
                         if (foundBook != NULL) displaySingle(foundBook);
                         break;
                     default:
@@ -165,7 +355,10 @@ int main ()
             case '4':
                 clearScreen();
                 printf(GREEN"\nThank you for using the Library Management System!\n\n"RESET);
-                freeAllBooks(&head);  // Free allocated memory before exit
+                freeAllBooks(&arena);  // Free allocated memory before exit
+                isbnIndexFree(&isbnIdx);
+                sortedIndexFree(&titleIdx);
+                sortedIndexFree(&authorIdx);
                 exit(0);
                 break;
             default:
@@ -176,23 +369,66 @@ int main ()
     }
 }
 
-// Function to free all allocated memory for books
-void freeAllBooks(book** head) {
-    book* current = *head;
-    book* next;
+// Function to free all allocated memory for books, one free per chunk
+void freeAllBooks(bookArena* arena) {
+    bookChunk* current = arena->first;
+    bookChunk* next;
 
     while (current != NULL) {
         next = current->next;
         free(current);
         current = next;
     }
+    free(arena->chunks);
     
-    *head = NULL;
+    arenaInit(arena);
 }
 
-// Function to clear the console screen (Windows-specific)
+// Work out once whether stdout is a console and whether it takes ANSI
+// escape sequences. Windows 10+ consoles only do after opting in.
+void terminalInit(void)
+{
+    terminal.isTerminal = fileIsTerminal(stdout);
+    terminal.ansi = false;
+    if (!terminal.isTerminal) return;
+#ifdef _WIN32
+    HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD mode = 0;
+    if (GetConsoleMode(console, &mode)) {
+        terminal.ansi = SetConsoleMode(console, mode | 0x0004) != 0;  // ENABLE_VIRTUAL_TERMINAL_PROCESSING
+    }
+#else
+    const char* term = getenv("TERM");
+    terminal.ansi = (term != NULL && strcmp(term, "dumb") != 0);
+#endif
+}
+
+// Clear the console and home the cursor. The escape sequence goes through
+// stdout's buffer, so it reaches the console in the same write as the
+// first line of the redrawn screen. Files and pipes are left untouched.
 void clearScreen() {
-    system("cls");
+    if (terminal.ansi) {
+        fputs("\x1b[H\x1b[2J\x1b[3J", stdout);
+        return;
+    }
+#ifdef _WIN32
+    // Consoles without ANSI support: blank the buffer through the console API
+    if (terminal.isTerminal) {
+        HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+        CONSOLE_SCREEN_BUFFER_INFO info;
+        COORD home = {0, 0};
+        DWORD written;
+        fflush(stdout);
+        if (GetConsoleScreenBufferInfo(console, &info)) {
+            DWORD cells = (DWORD)info.dwSize.X * (DWORD)info.dwSize.Y;
+            FillConsoleOutputCharacterA(console, ' ', cells, home, &written);
+            FillConsoleOutputAttribute(console, info.wAttributes, cells, home, &written);
+            SetConsoleCursorPosition(console, home);
+        }
+    }
+#else
+    if (terminal.isTerminal) putchar('\n');  // Dumb terminal: just separate the screens
+#endif
 }
 
 // Display the header/banner of the program
@@ -221,158 +457,854 @@ void waitForKeypress() {
     getchar();
 }
 
-// Create a new book node
-book* createNewBook() {
-    book* newBook = (book*)malloc(sizeof(book));
-    if (newBook == NULL) {
-        printf(RED"Memory allocation failed\n"RESET);
-        exit(1);
+// Monotonic wall-clock time in seconds, for timing long operations
+double nowSeconds(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+// Sleep for a number of milliseconds
+void pauseMs(int ms)
+{
+#ifdef _WIN32
+    Sleep((DWORD)ms);
+#else
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    nanosleep(&ts, NULL);
+#endif
+}
+
+// Start of a desk search: show the "Searching..." cue and start the clock
+double searchStarted(void)
+{
+    printf(YELLOW"\nSearching..."RESET);
+    fflush(stdout);
+    return nowSeconds();
+}
+
+// End of a desk search: report how long the lookup took. A cosmetic delay
+// (--search-delay) only pads whatever is left of it once the search is done.
+void searchFinished(double started)
+{
+    double elapsed = nowSeconds() - started;
+    printf(CYAN" (%.3f ms)"RESET, elapsed * 1000.0);
+
+    double remaining = searchDelayMs / 1000.0 - elapsed;
+    if (remaining > 0) {
+        fflush(stdout);
+        pauseMs((int)(remaining * 1000.0));
     }
-    
-    newBook->next = NULL;
+}
+
+void arenaInit(bookArena* arena) {
+    arena->first = NULL;
+    arena->last = NULL;
+    arena->chunks = NULL;
+    arena->chunkCount = 0;
+    arena->chunkCapacity = 0;
+    arena->count = 0;
+    arena->isbnSequence = 0;
+}
+
+// Hand out the next free book slot, adding a chunk when the last one is full
+book* createNewBook(bookArena* arena) {
+    if (arena->last == NULL || arena->last->used == BOOKS_PER_CHUNK) {
+        bookChunk* chunk = (bookChunk*)malloc(sizeof(bookChunk));
+        if (chunk == NULL) {
+            printf(RED"Memory allocation failed\n"RESET);
+            exit(1);
+        }
+
+        if (arena->chunkCount == arena->chunkCapacity) {
+            int capacity = (arena->chunkCapacity == 0) ? 16 : arena->chunkCapacity * 2;
+            bookChunk** chunks = (bookChunk**)realloc(arena->chunks, (size_t)capacity * sizeof(bookChunk*));
+            if (chunks == NULL) {
+                printf(RED"Memory allocation failed\n"RESET);
+                exit(1);
+            }
+            arena->chunks = chunks;
+            arena->chunkCapacity = capacity;
+        }
+        arena->chunks[arena->chunkCount++] = chunk;
+
+        chunk->used = 0;
+        chunk->next = NULL;
+        if (arena->last != NULL) {
+            arena->last->next = chunk;
+        } else {
+            arena->first = chunk;
+        }
+        arena->last = chunk;
+    }
+
+    book* newBook = &arena->last->books[arena->last->used++];
+    memset(newBook, 0, sizeof(book));
+    arena->count++;
     return newBook;
 }
 
-// Generate a unique isbn per book added
-void generateISBN(book* node)
+// Book number `position` (0 for the first added) in O(1): every chunk but
+// the last is full, so the position splits into chunk and slot
+book* arenaBook(const bookArena* arena, size_t position)
 {
-    srand(time(NULL) + (long)node); // Use pointer address for better randomness
-    
-    // Initialize isbn string
-    memset(node->isbn, 0, sizeof(node->isbn));
-    
-    // Generate ISBN format: XXXX-XXXX-XXXX-XXXX (all digits)
-    int j = 0;
-    for (int i = 0; i < 19; i++) {
-        if (i == 4 || i == 9 || i == 14) {
-            node->isbn[i] = '-';
+    return &arena->chunks[position / BOOKS_PER_CHUNK]->books[position % BOOKS_PER_CHUNK];
+}
+
+// Give a book the next ISBN from the arena's sequence, skipping any that
+// are already taken. Returns the ISBN.
+uint64_t generateISBN(bookArena* arena, const isbnIndex* isbnIdx, book* node)
+{
+    uint64_t isbn;
+
+    do {
+        isbn = isbnScramble(arena->isbnSequence++);
+    } while (isbnIndexFind(isbnIdx, isbn) != NULL);
+
+    node->isbn = isbn;
+    return isbn;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @ISBN INDEX FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+// ISBN-13 check digit for the first twelve digits: weights alternate 1, 3
+// from the left, so the rightmost of the twelve has weight 3
+static int isbnCheckDigit(uint64_t first12)
+{
+    int sum = 0;
+
+    for (int i = 0; i < 12; i++) {
+        int digit = (int)(first12 % 10);
+        sum += (i % 2 == 0) ? digit * 3 : digit;
+        first12 /= 10;
+    }
+    return (10 - sum % 10) % 10;
+}
+
+// Read an ISBN-13 or ISBN-10, bare or with hyphens/spaces, and check its
+// check digit. ISBN-10s are converted to their 978 ISBN-13.
+bool parseISBN(const char* text, uint64_t* isbn)
+{
+    uint64_t value = 0;
+    int digits = 0;
+    int sum10 = 0;      // ISBN-10 weighted sum, weights 10 down to 1
+    bool checkX = false;
+
+    for (size_t i = 0; text[i] != '\0'; i++) {
+        char c = text[i];
+        if (c == '-' || c == ' ') continue;
+        if (checkX || digits == 13) return false;
+
+        if (c >= '0' && c <= '9') {
+            value = value * 10 + (uint64_t)(c - '0');
+            if (digits < 10) sum10 += (10 - digits) * (c - '0');
+            digits++;
+        } else if ((c == 'X' || c == 'x') && digits == 9) {
+            sum10 += 10;  // X stands for 10, only as an ISBN-10 check digit
+            digits++;
+            checkX = true;
         } else {
-            node->isbn[i] = '0' + (rand() % 10);  // Generate digits 0-9
+            return false;
         }
     }
-    node->isbn[19] = '\0'; // Ensure null termination
+
+    if (digits == 10) {
+        if (sum10 % 11 != 0) return false;
+        uint64_t first9 = checkX ? value : value / 10;
+        uint64_t first12 = 978000000000ULL + first9;
+        *isbn = first12 * 10 + (uint64_t)isbnCheckDigit(first12);
+        return true;
+    }
+
+    if (digits != 13) return false;
+    uint64_t prefix = value / 10000000000ULL;
+    if ((prefix != 978 && prefix != 979) || (int)(value % 10) != isbnCheckDigit(value / 10)) {
+        return false;
+    }
+    *isbn = value;
+    return true;
+}
+
+// Mix the key bits so sequential ISBNs spread across the table
+static size_t isbnHash(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return (size_t)key;
+}
+
+static isbnSlot* allocIsbnSlots(size_t capacity)
+{
+    isbnSlot* slots = (isbnSlot*)malloc(capacity * sizeof(isbnSlot));
+    if (slots == NULL) {
+        printf(RED"Memory allocation failed\n"RESET);
+        exit(1);
+    }
+
+    for (size_t i = 0; i < capacity; i++) {
+        slots[i].node = NULL;
+    }
+    return slots;
+}
+
+void isbnIndexInit(isbnIndex* idx)
+{
+    idx->capacity = ISBN_INDEX_INITIAL_CAPACITY;
+    idx->count = 0;
+    idx->slots = allocIsbnSlots(idx->capacity);
+}
+
+void isbnIndexFree(isbnIndex* idx)
+{
+    free(idx->slots);
+    idx->slots = NULL;
+    idx->capacity = 0;
+    idx->count = 0;
+}
+
+// Double the table and re-place every occupied slot
+static void isbnIndexGrow(isbnIndex* idx)
+{
+    size_t newCapacity = idx->capacity * 2;
+    size_t mask = newCapacity - 1;
+    isbnSlot* newSlots = allocIsbnSlots(newCapacity);
+
+    for (size_t i = 0; i < idx->capacity; i++) {
+        if (idx->slots[i].node == NULL) continue;
+
+        size_t pos = isbnHash(idx->slots[i].key) & mask;
+        while (newSlots[pos].node != NULL) {
+            pos = (pos + 1) & mask;
+        }
+        newSlots[pos] = idx->slots[i];
+    }
+
+    free(idx->slots);
+    idx->slots = newSlots;
+    idx->capacity = newCapacity;
+}
+
+// Insert a key; returns false if the key is already indexed
+bool isbnIndexInsert(isbnIndex* idx, uint64_t key, book* node)
+{
+    // Keep the load factor at or below 1/2 so probe chains stay short
+    if ((idx->count + 1) * 2 > idx->capacity) {
+        isbnIndexGrow(idx);
+    }
+
+    size_t mask = idx->capacity - 1;
+    size_t pos = isbnHash(key) & mask;
+
+    while (idx->slots[pos].node != NULL) {
+        if (idx->slots[pos].key == key) return false;
+        pos = (pos + 1) & mask;
+    }
+
+    idx->slots[pos].key = key;
+    idx->slots[pos].node = node;
+    idx->count++;
+    return true;
+}
+
+// Find the book stored under a key, or NULL if absent
+book* isbnIndexFind(const isbnIndex* idx, uint64_t key)
+{
+    size_t mask = idx->capacity - 1;
+    size_t pos = isbnHash(key) & mask;
+
+    while (idx->slots[pos].node != NULL) {
+        if (idx->slots[pos].key == key) return idx->slots[pos].node;
+        pos = (pos + 1) & mask;
+    }
+    return NULL;
 }
 
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-    @SEARCH FUNCTIONS
+    @ISBN ALLOCATOR FUNCTIONS
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
-// Search book by book title
-book* searchByTitle(book* head, int bookCount)
+// "00" to "99", so numbers are formatted two digits per lookup
+static const char digitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static uint32_t scrambleRound(uint32_t half, int round)
+{
+    uint64_t x = ((uint64_t)half << 8 | (uint64_t)round) ^ ISBN_SCRAMBLE_KEY;
+    x ^= x >> 31;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 29;
+    return (uint32_t)x & ((1u << ISBN_SCRAMBLE_HALF_BITS) - 1);
+}
+
+// Feistel network over two 15-bit halves: a bijection on 30-bit values
+static uint32_t scrambleBits(uint32_t value)
+{
+    uint32_t left = value >> ISBN_SCRAMBLE_HALF_BITS;
+    uint32_t right = value & ((1u << ISBN_SCRAMBLE_HALF_BITS) - 1);
+
+    for (int round = 0; round < ISBN_SCRAMBLE_ROUNDS; round++) {
+        uint32_t mixed = left ^ scrambleRound(right, round);
+        left = right;
+        right = mixed;
+    }
+    return left << ISBN_SCRAMBLE_HALF_BITS | right;
+}
+
+// Map a sequence number to a generated ISBN-13 (979 prefix, check digit
+// included). Scrambling is repeated until the value falls below
+// ISBN_BODY_SPACE (cycle walking), which keeps it a bijection on the
+// 9-digit body, so distinct sequence numbers never give the same ISBN.
+uint64_t isbnScramble(uint64_t sequence)
+{
+    uint32_t body = (uint32_t)(sequence % ISBN_BODY_SPACE);
+
+    do {
+        body = scrambleBits(body);
+    } while (body >= ISBN_BODY_SPACE);
+
+    uint64_t first12 = ISBN_GENERATED_PREFIX * ISBN_BODY_SPACE + body;
+    return first12 * 10 + (uint64_t)isbnCheckDigit(first12);
+}
+
+// Write an ISBN-13 as prefix-body-check (e.g. 979-123456789-7) into an
+// ISBN_TEXT_SIZE buffer. Only display code needs the text form.
+void formatISBN(uint64_t isbn, char* out)
+{
+    char digits[13];
+
+    digits[12] = (char)('0' + isbn % 10);
+    isbn /= 10;
+    for (int i = 10; i >= 0; i -= 2) {
+        memcpy(&digits[i], &digitPairs[(isbn % 100) * 2], 2);
+        isbn /= 100;
+    }
+
+    memcpy(out, digits, 3);
+    out[3] = '-';
+    memcpy(out + 4, digits + 3, 9);
+    out[13] = '-';
+    out[14] = digits[12];
+    out[15] = '\0';
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @SORTED INDEX FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+// Build the folded key for a field: lower-case it once and hash the result
+void foldKey(foldedKey* key, const char* text)
+{
+    uint32_t hash = 2166136261u;
+    size_t len = 0;
+
+    while (text[len] != '\0' && len < sizeof(key->text) - 1) {
+        char folded = (char)tolower((unsigned char)text[len]);
+        key->text[len] = folded;
+        hash = (hash ^ (uint8_t)folded) * 16777619u;
+        len++;
+    }
+
+    key->text[len] = '\0';
+    key->length = (uint8_t)len;
+    key->hash = hash;
+}
+
+// Byte order of two folded keys; no per-character case folding needed
+static int compareKeys(const foldedKey* a, const foldedKey* b)
+{
+    size_t len = (a->length < b->length) ? a->length : b->length;
+    int diff = memcmp(a->text, b->text, len);
+    if (diff != 0) return diff;
+    return (int)a->length - (int)b->length;
+}
+
+// Compare only the first prefix->length bytes of a key against prefix
+static int comparePrefix(const foldedKey* key, const foldedKey* prefix)
+{
+    size_t len = (key->length < prefix->length) ? key->length : prefix->length;
+    int diff = memcmp(key->text, prefix->text, len);
+    if (diff != 0) return diff;
+    return (key->length < prefix->length) ? -1 : 0;
+}
+
+// Equality check: hash first, then length, then bytes
+static bool keysEqual(const foldedKey* a, const foldedKey* b)
+{
+    return a->hash == b->hash
+        && a->length == b->length
+        && memcmp(a->text, b->text, a->length) == 0;
+}
+
+static const foldedKey* indexKey(const sortedIndex* idx, const book* node)
+{
+    return (const foldedKey*)((const char*)node + idx->keyOffset);
+}
+
+static int compareEntries(const sortedIndex* idx, const book* a, const book* b)
+{
+    return compareKeys(indexKey(idx, a), indexKey(idx, b));
+}
+
+// Stable merge sort of a batch of nodes, using scratch as the work buffer
+static void sortNodes(const sortedIndex* idx, book** nodes, book** scratch, size_t n)
+{
+    if (n < 2) return;
+
+    size_t half = n / 2;
+    sortNodes(idx, nodes, scratch, half);
+    sortNodes(idx, nodes + half, scratch, n - half);
+
+    size_t i = 0, j = half, k = 0;
+    while (i < half && j < n) {
+        scratch[k++] = (compareEntries(idx, nodes[j], nodes[i]) < 0) ? nodes[j++] : nodes[i++];
+    }
+    while (i < half) scratch[k++] = nodes[i++];
+    while (j < n) scratch[k++] = nodes[j++];
+    memcpy(nodes, scratch, n * sizeof(book*));
+}
+
+static void* allocOrExit(size_t size)
+{
+    void* block = malloc(size);
+    if (block == NULL) {
+        printf(RED"Memory allocation failed\n"RESET);
+        exit(1);
+    }
+    return block;
+}
+
+void sortedIndexInit(sortedIndex* idx, size_t keyOffset)
+{
+    idx->order = NULL;
+    idx->count = 0;
+    idx->capacity = 0;
+    idx->keyOffset = keyOffset;
+}
+
+void sortedIndexFree(sortedIndex* idx)
+{
+    free(idx->order);
+    idx->order = NULL;
+    idx->count = 0;
+    idx->capacity = 0;
+}
+
+// Number of entries in order[0, count) that sort at or before node. The
+// batch is merged largest first, so the answer is usually near count: gallop
+// back from the end, then binary search the last step.
+static size_t entriesNotAfter(const sortedIndex* idx, book* const* order, size_t count, const book* node)
+{
+    size_t high = count, step = 1;
+    while (step <= high && compareEntries(idx, order[high - step], node) > 0) {
+        high -= step;
+        step *= 2;
+    }
+
+    size_t low = (step <= high) ? high - step + 1 : 0;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (compareEntries(idx, order[mid], node) > 0) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return low;
+}
+
+// Add a batch of new nodes by sorting only the batch and merging it into the
+// existing order from the back, so the catalog is never re-sorted. Existing
+// entries move up in blocks found by binary search, so the key comparisons
+// grow with the batch rather than with the catalog.
+void sortedIndexInsertBatch(sortedIndex* idx, book** nodes, int count)
+{
+    if (count <= 0) return;
+
+    size_t total = idx->count + (size_t)count;
+    if (total > idx->capacity) {
+        size_t newCapacity = idx->capacity ? idx->capacity : 64;
+        while (newCapacity < total) newCapacity *= 2;
+
+        book** grown = (book**)realloc(idx->order, newCapacity * sizeof(book*));
+        if (grown == NULL) {
+            printf(RED"Memory allocation failed\n"RESET);
+            exit(1);
+        }
+        idx->order = grown;
+        idx->capacity = newCapacity;
+    }
+
+    book** batch = (book**)allocOrExit(2 * (size_t)count * sizeof(book*));
+    book** scratch = batch + count;
+    memcpy(batch, nodes, (size_t)count * sizeof(book*));
+    sortNodes(idx, batch, scratch, (size_t)count);
+
+    // Merge from the back so existing entries are shifted at most once
+    size_t i = idx->count;
+    size_t j = (size_t)count;
+    size_t k = total;
+    while (j > 0) {
+        size_t keep = entriesNotAfter(idx, idx->order, i, batch[j - 1]);
+        k -= i - keep;
+        memmove(idx->order + k, idx->order + keep, (i - keep) * sizeof(book*));
+        i = keep;
+        idx->order[--k] = batch[--j];
+    }
+
+    idx->count = total;
+    free(batch);
+}
+
+// First position whose key is >= key
+static size_t lowerBound(const sortedIndex* idx, const foldedKey* key)
+{
+    size_t low = 0, high = idx->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (compareKeys(indexKey(idx, idx->order[mid]), key) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// First position whose key is > key (or, for a prefix, no longer starts with it)
+static size_t upperBound(const sortedIndex* idx, const foldedKey* key, bool prefix)
+{
+    size_t low = 0, high = idx->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        const foldedKey* field = indexKey(idx, idx->order[mid]);
+        int diff = prefix ? comparePrefix(field, key) : compareKeys(field, key);
+        if (diff <= 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// All entries equal to key; the run of equal keys is walked with keysEqual
+indexRange sortedIndexExact(const sortedIndex* idx, const foldedKey* key)
+{
+    indexRange range;
+    range.first = lowerBound(idx, key);
+    range.last = range.first;
+    while (range.last < idx->count && keysEqual(indexKey(idx, idx->order[range.last]), key)) {
+        range.last++;
+    }
+    return range;
+}
+
+// All entries starting with prefix
+indexRange sortedIndexPrefix(const sortedIndex* idx, const foldedKey* prefix)
+{
+    indexRange range = { lowerBound(idx, prefix), upperBound(idx, prefix, true) };
+    return range;
+}
+
+// Open a cursor on rows [range.first, range.last). With a NULL index the
+// rows are book positions in the arena, i.e. the order books were added.
+void cursorOpen(bookCursor* cur, const bookArena* arena, const sortedIndex* idx, indexRange range)
+{
+    cur->arena = arena;
+    cur->idx = idx;
+    cur->first = range.first;
+    cur->last = range.last;
+    cur->position = range.first;
+}
+
+// Move to the row `offset` rows into the cursor's range in O(1); returns
+// false (leaving the cursor at the end) if the offset is past the range
+bool cursorSeek(bookCursor* cur, size_t offset)
+{
+    if (offset >= cur->last - cur->first) {
+        cur->position = cur->last;
+        return false;
+    }
+    cur->position = cur->first + offset;
+    return true;
+}
+
+size_t cursorCount(const bookCursor* cur)
+{
+    return cur->last - cur->first;
+}
+
+// Book at the next row, or NULL once the range is used up
+book* cursorNext(bookCursor* cur)
+{
+    if (cur->position >= cur->last) return NULL;
+
+    size_t row = cur->position++;
+    return (cur->idx != NULL) ? cur->idx->order[row] : arenaBook(cur->arena, row);
+}
+
+// Look a query up in a sorted index; a trailing '*' makes it a prefix search.
+// The query is folded once here and every match is ranked into res.
+static void lookupSorted(const sortedIndex* idx, char* query, searchResult* res)
 {
-    book* current = head;
+    size_t len = strlen(query);
+    bool prefix = (len > 0 && query[len - 1] == '*');
+    foldedKey key;
+
+    if (prefix) query[len - 1] = '\0';
+    foldKey(&key, query);
+    searchRange(idx, prefix ? sortedIndexPrefix(idx, &key) : sortedIndexExact(idx, &key), &key, res);
+}
+
+// List the hits of a finished search and let the user pick one. A single
+// match is returned straight away. Returns the chosen book or NULL.
+static book* pickResult(const searchResult* res)
+{
+    int choice = 0;
+
+    if (res->count == 0) {
+        printf(RED"\nBook is not found.\n"RESET);
+        return NULL;
+    }
+    if (res->total == 1) {
+        printf(GREEN"\nBook is found!\n"RESET);
+        return res->hits[0].node;
+    }
+
+    if (res->count < res->total) {
+        printf(GREEN"\n%zu matching books, best %zu shown:\n"RESET, res->total, res->count);
+    } else {
+        printf(GREEN"\n%zu matching books:\n"RESET, res->total);
+    }
+    for (size_t i = 0; i < res->count; i++) {
+        printf(CYAN"~~ %zu - "GREEN"%s"CYAN" by "GREEN"%s\n"RESET, i + 1,
+               res->hits[i].node->title, res->hits[i].node->author);
+    }
+
+    printf(YELLOW"Select a book (0 to cancel): "RESET);
+    scanf("%d", &choice);
+    while (getchar() != '\n');  // Clear input buffer
+
+    return (choice >= 1 && (size_t)choice <= res->count) ? res->hits[choice - 1].node : NULL;
+}
+
+// Search book by book title using the sorted title index
+book* searchByTitle(sortedIndex* titleIdx)
+{
+    searchResult res;
     char titleToSearch[50];  // Match size with book structure
 
     printf(CYAN"\n<=======================================>\n"
            "||             SEARCH BY TITLE            ||\n"
            "<=======================================>\n"RESET);
-    printf(CYAN"Enter book title: "RESET);
+    printf(CYAN"Enter book title (end with * to match a prefix): "RESET);
     scanf(" %49[^\n]", titleToSearch);  // Prevent buffer overflow
     while (getchar() != '\n');  // Clear input buffer
 
-    printf(YELLOW"\nSearching..."RESET);
-    Sleep(500); // Add a small delay for better UX
-    
-    int i = 0;
-    while (current != NULL) {
-        char bookTitle[50];
-        char searchTitle[50];
-        
-        // Create temporary copies for the strlwr function
-        strcpy(bookTitle, current->title);
-        strcpy(searchTitle, titleToSearch);
-        
-        if (strcmp(strlwr(bookTitle), strlwr(searchTitle)) == 0) {
-            printf(GREEN"\nBook is found!\n"RESET);
-            return current;
-        }
-        current = current->next;
-        i++;
-    }
+    double started = searchStarted();
+    resultInit(&res, SEARCH_DEFAULT_LIMIT);
+    lookupSorted(titleIdx, titleToSearch, &res);
+    resultFinish(&res);
+    searchFinished(started);
 
-    printf(RED"\nBook is not found.\n"RESET);
-    return NULL;
+    book* found = pickResult(&res);
+    resultFree(&res);
+    return found;
 }
 
-// Search book by author
-book* searchByAuthor(book* head, int bookCount)
+// Search book by author using the sorted author index
+book* searchByAuthor(sortedIndex* authorIdx)
 {
-    book* current = head;
+    searchResult res;
     char authorToSearch[50];  // Match size with book structure
 
     printf(CYAN"\n<=======================================>\n"
            "||             SEARCH BY AUTHOR           ||\n"
            "<=======================================>\n"RESET);
-    printf(CYAN"Enter author name: "RESET);
+    printf(CYAN"Enter author name (end with * to match a prefix): "RESET);
     scanf(" %49[^\n]", authorToSearch);  // Prevent buffer overflow
     while (getchar() != '\n');  // Clear input buffer
 
-    printf(YELLOW"\nSearching..."RESET);
-    Sleep(500); // Add a small delay for better UX
-
-    int i = 0;
-    while (current != NULL) {
-        char bookAuthor[50];
-        char searchAuthor[50];
-        
-        // Create temporary copies for the strlwr function
-        strcpy(bookAuthor, current->author);
-        strcpy(searchAuthor, authorToSearch);
-        
-        if (strcmp(strlwr(bookAuthor), strlwr(searchAuthor)) == 0) {
-            printf(GREEN"\nBook is found!\n"RESET);
-            return current;
-        }
-        current = current->next;
-        i++;
-    }
+    double started = searchStarted();
+    resultInit(&res, SEARCH_DEFAULT_LIMIT);
+    lookupSorted(authorIdx, authorToSearch, &res);
+    resultFinish(&res);
+    searchFinished(started);
 
-    printf(RED"\nBook is not found.\n"RESET);
-    return NULL;
+    book* found = pickResult(&res);
+    resultFree(&res);
+    return found;
 }
 
-// Search book by book isbn
-book* searchByISBN(book* head, int bookCount)
+// Search book by book isbn using the hash index
+book* searchByISBN(isbnIndex* isbnIdx)
 {
-    book* current = head;
-    char isbnToSearch[20];  // Match size with book structure
+    uint64_t key;
+    char isbnToSearch[ISBN_INPUT_SIZE];
 
     printf(CYAN"\n<=======================================>\n"
            "||              SEARCH BY ISBN             ||\n"
            "<=======================================>\n"RESET);
     printf(CYAN"Enter ISBN: "RESET);
-    scanf(" %19[^\n]", isbnToSearch);  // Prevent buffer overflow
+    scanf(" %31[^\n]", isbnToSearch);  // Prevent buffer overflow
     while (getchar() != '\n');  // Clear input buffer
 
-    printf(YELLOW"\nSearching..."RESET);
-    Sleep(500); // Add a small delay for better UX
+    if (!parseISBN(isbnToSearch, &key))
+    {
+        printf(RED"\nNot a valid ISBN-13 or ISBN-10 (check the digits).\n"RESET);
+        return NULL;
+    }
 
-    int i = 0;
-    while (current != NULL) {
-        char bookISBN[20];
-        char searchISBN[20];
-        
-        // Create temporary copies for the strlwr function
-        strcpy(bookISBN, current->isbn);
-        strcpy(searchISBN, isbnToSearch);
-        
-        if (strcmp(strlwr(bookISBN), strlwr(searchISBN)) == 0) {
-            printf(GREEN"\nBook is found!\n"RESET);
-            return current;
-        }
-        current = current->next;
-        i++;
+    double started = searchStarted();
+    book* found = isbnIndexFind(isbnIdx, key);
+    searchFinished(started);
+    if (found != NULL)
+    {
+        printf(GREEN"\nBook is found!\n"RESET);
+        return found;
     }
 
     printf(RED"\nBook is not found.\n"RESET);
     return NULL;
 }
 
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @RANKED SEARCH FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+// Score how well a folded key matches a folded query, or 0 if it does not
+// start with it: the whole field beats a prefix, then a shorter field wins
+uint32_t matchScore(const foldedKey* key, const foldedKey* query)
+{
+    if (key->length < query->length) return 0;
+    if (memcmp(key->text, query->text, query->length) != 0) return 0;
+
+    uint32_t exact = (key->length == query->length) ? 1u : 0u;
+    return (exact << 8) | (uint32_t)(255 - (key->length - query->length));
+}
+
+// True if hit a ranks below hit b; equal scores keep index order
+static bool hitWorse(const searchHit* a, const searchHit* b)
+{
+    return (a->score != b->score) ? a->score < b->score : a->row > b->row;
+}
+
+static void heapSiftUp(searchHit* hits, size_t i)
+{
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!hitWorse(&hits[i], &hits[parent])) break;
+        searchHit tmp = hits[i];
+        hits[i] = hits[parent];
+        hits[parent] = tmp;
+        i = parent;
+    }
+}
+
+static void heapSiftDown(searchHit* hits, size_t count, size_t i)
+{
+    for (;;) {
+        size_t worst = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < count && hitWorse(&hits[left], &hits[worst])) worst = left;
+        if (right < count && hitWorse(&hits[right], &hits[worst])) worst = right;
+        if (worst == i) return;
+        searchHit tmp = hits[i];
+        hits[i] = hits[worst];
+        hits[worst] = tmp;
+        i = worst;
+    }
+}
+
+void resultInit(searchResult* res, size_t limit)
+{
+    res->limit = limit;
+    res->capacity = (limit > 0) ? limit : 64;
+    res->hits = (searchHit*)allocOrExit(res->capacity * sizeof(searchHit));
+    res->count = 0;
+    res->total = 0;
+}
+
+// Consider one match. Once the result is full, a new hit only gets in by
+// replacing the weakest one kept: O(log K) per match.
+void resultOffer(searchResult* res, book* node, size_t row, uint32_t score)
+{
+    searchHit hit = {node, row, score};
+
+    res->total++;
+    if (res->limit > 0 && res->count == res->limit) {
+        if (hitWorse(&res->hits[0], &hit)) {
+            res->hits[0] = hit;
+            heapSiftDown(res->hits, res->count, 0);
+        }
+        return;
+    }
+
+    if (res->count == res->capacity) {
+        searchHit* grown = (searchHit*)realloc(res->hits, 2 * res->capacity * sizeof(searchHit));
+        if (grown == NULL) {
+            printf(RED"Memory allocation failed\n"RESET);
+            exit(1);
+        }
+        res->hits = grown;
+        res->capacity *= 2;
+    }
+    res->hits[res->count] = hit;
+    heapSiftUp(res->hits, res->count++);
+}
+
+// Turn the heap into a best-first list by popping the weakest hit to the back
+void resultFinish(searchResult* res)
+{
+    for (size_t end = res->count; end > 1; end--) {
+        searchHit tmp = res->hits[0];
+        res->hits[0] = res->hits[end - 1];
+        res->hits[end - 1] = tmp;
+        heapSiftDown(res->hits, end - 1, 0);
+    }
+}
+
+void resultFree(searchResult* res)
+{
+    free(res->hits);
+    res->hits = NULL;
+    res->count = 0;
+}
+
+// Rank the books in one range of a sorted index, e.g. an exact or prefix
+// match, in a single pass over the range
+void searchRange(const sortedIndex* idx, indexRange range, const foldedKey* query, searchResult* res)
+{
+    for (size_t row = range.first; row < range.last; row++) {
+        book* node = idx->order[row];
+        resultOffer(res, node, row, matchScore(indexKey(idx, node), query));
+    }
+}
+
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     @STORE FUNCTION
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
-void store(book** head, int* bookCount) {
+void store(bookArena* arena, isbnIndex* isbnIdx, sortedIndex* titleIdx, sortedIndex* authorIdx) {
     int count = 0;
     printf(CYAN"\n<=======================================>\n"
            "||               ADD BOOKS                ||\n"
@@ -386,6 +1318,9 @@ void store(book** head, int* bookCount) {
         return;
     }
     
+    // Collect the new nodes so the sorted indexes can merge them in one pass
+    book** added = (book**)allocOrExit((size_t)count * sizeof(book*));
+
     for (int i = 0; i < count; i++) {
         clearScreen();
         displayHeader();
@@ -394,7 +1329,7 @@ void store(book** head, int* bookCount) {
                "<=======================================>\n"RESET);
         printf(YELLOW"\nBook #%d of %d:\n"RESET, i + 1, count);
         
-        book* newBook = createNewBook();
+        book* newBook = createNewBook(arena);
         
         printf(YELLOW"Book Title: "RESET);
         scanf(" %49[^\n]", newBook->title);  // Prevent buffer overflow
@@ -404,44 +1339,477 @@ void store(book** head, int* bookCount) {
         scanf(" %49[^\n]", newBook->author);  // Prevent buffer overflow
         while (getchar() != '\n');  // Clear input buffer
 
-        generateISBN(newBook);
         newBook->status = AVAILABLE;
-        
-        // Add the new book to the beginning of the list for efficiency
-        newBook->next = *head;
-        *head = newBook;
+        foldKey(&newBook->titleKey, newBook->title);
+        foldKey(&newBook->authorKey, newBook->author);
+
+        // Generated ISBNs are never already in the index
+        isbnIndexInsert(isbnIdx, generateISBN(arena, isbnIdx, newBook), newBook);
+        added[i] = newBook;
     }
+
+    sortedIndexInsertBatch(titleIdx, added, count);
+    sortedIndexInsertBatch(authorIdx, added, count);
+    free(added);
     
-    *bookCount += count;
-    printf(GREEN"\nSuccessfully added %d books. Total books: %d\n"RESET, count, *bookCount);
+    printf(GREEN"\nSuccessfully added %d books. Total books: %d\n"RESET, count, arena->count);
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @OUTPUT FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+bool fileIsTerminal(FILE* file)
+{
+#ifdef _WIN32
+    return _isatty(_fileno(file)) != 0;
+#else
+    return isatty(fileno(file)) != 0;
+#endif
+}
+
+void outputInit(outputBuffer* out)
+{
+    out->data = allocOrExit(OUTPUT_BUFFER_SIZE);
+    out->length = 0;
+    out->color = terminal.isTerminal;
+}
+
+// Write the buffered bytes straight to the stdout descriptor. stdio is
+// flushed first so earlier printf output still comes out in order.
+void outputFlush(outputBuffer* out)
+{
+    size_t written = 0;
+
+    fflush(stdout);
+    while (written < out->length) {
+#ifdef _WIN32
+        int n = _write(_fileno(stdout), out->data + written, (unsigned int)(out->length - written));
+#else
+        ssize_t n = write(fileno(stdout), out->data + written, out->length - written);
+#endif
+        if (n <= 0) break;  // Reader went away; drop the rest
+        written += (size_t)n;
+    }
+    out->length = 0;
+}
+
+void outputFree(outputBuffer* out)
+{
+    outputFlush(out);
+    free(out->data);
+    out->data = NULL;
+}
+
+static void outputBytes(outputBuffer* out, const char* text, size_t len)
+{
+    while (len > 0) {
+        if (out->length == OUTPUT_BUFFER_SIZE) outputFlush(out);
+
+        size_t room = OUTPUT_BUFFER_SIZE - out->length;
+        size_t n = (len < room) ? len : room;
+        memcpy(out->data + out->length, text, n);
+        out->length += n;
+        text += n;
+        len -= n;
+    }
+}
+
+static void outputText(outputBuffer* out, const char* text)
+{
+    outputBytes(out, text, strlen(text));
+}
+
+// Color escapes are skipped entirely in plain mode
+static void outputColor(outputBuffer* out, const char* color)
+{
+    if (out->color) outputText(out, color);
+}
+
+static void outputInt(outputBuffer* out, long long value)
+{
+    char digits[24];
+    int pos = sizeof(digits);
+    bool negative = value < 0;
+    unsigned long long magnitude = negative ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+
+    do {
+        digits[--pos] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (negative) digits[--pos] = '-';
+
+    outputBytes(out, digits + pos, sizeof(digits) - (size_t)pos);
+}
+
+// One "~~> Label: value" line, label in cyan and value in `valueColor`
+static void outputField(outputBuffer* out, const char* label, const char* value, const char* valueColor)
+{
+    outputColor(out, CYAN);
+    outputText(out, label);
+    outputColor(out, valueColor);
+    outputText(out, value);
+    outputColor(out, RESET);
+    outputBytes(out, "\n", 1);
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @BENCHMARK FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+// One listing line, the same text the array version's batch "list" prints
+static void benchBookLine(outputBuffer* out, const book* node)
+{
+    char isbn[ISBN_TEXT_SIZE];
+
+    formatISBN(node->isbn, isbn);
+    outputText(out, "book ");
+    outputText(out, isbn);
+    outputBytes(out, "\t", 1);
+    outputText(out, node->title);
+    outputBytes(out, "\t", 1);
+    outputText(out, node->author);
+    outputText(out, bookGetStatus(node) == AVAILABLE ? "\tavailable\n" : "\tchecked-out\n");
+}
+
+// Time the chunked linked list on a synthetic library: adding books in
+// batches, ISBN lookups, exact title searches, desk check-outs/returns and
+// full listings, with the same workload and report as the array version's
+// --bench. Returns false if a lookup did not find the book it was looking for.
+bool runBench(const benchConfig* config)
+{
+    bookArena arena;
+    isbnIndex isbnIdx;
+    sortedIndex titleIdx;
+    sortedIndex authorIdx;
+    zipfTable words;
+    zipfTable authors;
+    zipfTable books;
+    benchPhase phase;
+    outputBuffer out;
+    uint64_t state = config->seed;
+    int n = config->books;
+    bool found = true;
+
+    arenaInit(&arena);
+    isbnIndexInit(&isbnIdx);
+    sortedIndexInit(&titleIdx, offsetof(book, titleKey));
+    sortedIndexInit(&authorIdx, offsetof(book, authorKey));
+    zipfInit(&words, BENCH_VOCABULARY, config->zipf);
+    zipfInit(&authors, (n + BENCH_BOOKS_PER_AUTHOR - 1) / BENCH_BOOKS_PER_AUTHOR, config->zipf);
+    benchHeader("linked list", config);
+
+    // Each batch is generated untimed, then added the way store adds the
+    // books typed in, with one merge into the sorted indexes per batch
+    char (*titles)[50] = allocOrExit(BENCH_INSERT_BATCH * sizeof(*titles));
+    char (*names)[50] = allocOrExit(BENCH_INSERT_BATCH * sizeof(*names));
+    book** added = allocOrExit(BENCH_INSERT_BATCH * sizeof(book*));
+    book** nodes = allocOrExit((size_t)n * sizeof(book*));  // Books in the order added
+    phaseInit(&phase);
+    for (int done = 0; done < n; done += BENCH_INSERT_BATCH) {
+        int batch = (n - done < BENCH_INSERT_BATCH) ? n - done : BENCH_INSERT_BATCH;
+        for (int i = 0; i < batch; i++) {
+            benchTitle(titles[i], sizeof(titles[i]), &words, &state);
+            benchAuthor(names[i], sizeof(names[i]), zipfNext(&authors, &state));
+        }
+
+        double started = nowSeconds();
+        for (int i = 0; i < batch; i++) {
+            book* newBook = createNewBook(&arena);
+            memcpy(newBook->title, titles[i], sizeof(newBook->title));
+            memcpy(newBook->author, names[i], sizeof(newBook->author));
+            newBook->status = AVAILABLE;
+            foldKey(&newBook->titleKey, newBook->title);
+            foldKey(&newBook->authorKey, newBook->author);
+            isbnIndexInsert(&isbnIdx, generateISBN(&arena, &isbnIdx, newBook), newBook);
+            added[i] = newBook;
+        }
+        sortedIndexInsertBatch(&titleIdx, added, batch);
+        sortedIndexInsertBatch(&authorIdx, added, batch);
+        phaseRecord(&phase, nowSeconds() - started, batch);
+        memcpy(nodes + done, added, (size_t)batch * sizeof(book*));
+    }
+    phaseReport(&phase, "insert");
+    free(titles);
+    free(names);
+    free(added);
+
+    zipfInit(&books, n, config->zipf);
+    int* popular = benchPermutation(n, &state);  // Position of the book with each popularity rank
+
+    // Lookups are timed BENCH_TIMED_OPS at a time on books drawn beforehand
+    book* targets[BENCH_TIMED_OPS];
+    uint64_t isbns[BENCH_TIMED_OPS];
+    book* hits[BENCH_TIMED_OPS];
+    bool results[BENCH_TIMED_OPS];
+    phaseInit(&phase);
+    for (int q = 0; q < BENCH_QUERIES; q += BENCH_TIMED_OPS) {
+        for (int i = 0; i < BENCH_TIMED_OPS; i++) {
+            targets[i] = nodes[popular[zipfNext(&books, &state)]];
+            isbns[i] = targets[i]->isbn;
+        }
+
+        double started = nowSeconds();
+        for (int i = 0; i < BENCH_TIMED_OPS; i++) {
+            hits[i] = isbnIndexFind(&isbnIdx, isbns[i]);
+        }
+        phaseRecord(&phase, nowSeconds() - started, BENCH_TIMED_OPS);
+        for (int i = 0; i < BENCH_TIMED_OPS; i++) {
+            if (hits[i] != targets[i]) found = false;
+        }
+    }
+    phaseReport(&phase, "isbn lookup");
+
+    char (*queries)[50] = allocOrExit(BENCH_TIMED_OPS * sizeof(*queries));
+    phaseInit(&phase);
+    for (int q = 0; q < BENCH_QUERIES; q += BENCH_TIMED_OPS) {
+        for (int i = 0; i < BENCH_TIMED_OPS; i++) {
+            memcpy(queries[i], nodes[popular[zipfNext(&books, &state)]]->title, sizeof(queries[i]));
+        }
+
+        double started = nowSeconds();
+        for (int i = 0; i < BENCH_TIMED_OPS; i++) {
+            foldedKey key;
+            searchResult res;
+            foldKey(&key, queries[i]);
+            resultInit(&res, SEARCH_DEFAULT_LIMIT);
+            searchRange(&titleIdx, sortedIndexExact(&titleIdx, &key), &key, &res);
+            resultFinish(&res);
+            results[i] = res.total > 0;
+            resultFree(&res);
+        }
+        phaseRecord(&phase, nowSeconds() - started, BENCH_TIMED_OPS);
+        for (int i = 0; i < BENCH_TIMED_OPS; i++) {
+            if (!results[i]) found = false;
+        }
+    }
+    phaseReport(&phase, "title search");
+    free(queries);
+
+    // A desk action: find the book by ISBN, then change its status. Each
+    // drawn book is checked out and returned, so both always succeed.
+    phaseInit(&phase);
+    for (int q = 0; q < BENCH_QUERIES; q += BENCH_TIMED_OPS) {
+        for (int i = 0; i < BENCH_TIMED_OPS / 2; i++) {
+            isbns[i] = nodes[popular[zipfNext(&books, &state)]]->isbn;
+        }
+
+        double started = nowSeconds();
+        for (int i = 0; i < BENCH_TIMED_OPS / 2; i++) {
+            book* node = isbnIndexFind(&isbnIdx, isbns[i]);
+            results[2 * i] = node != NULL && bookChangeStatus(node, AVAILABLE, CHECKED_OUT);
+            node = isbnIndexFind(&isbnIdx, isbns[i]);
+            results[2 * i + 1] = node != NULL && bookChangeStatus(node, CHECKED_OUT, AVAILABLE);
+        }
+        phaseRecord(&phase, nowSeconds() - started, BENCH_TIMED_OPS);
+        for (int i = 0; i < BENCH_TIMED_OPS; i++) {
+            if (!results[i]) found = false;
+        }
+    }
+    phaseReport(&phase, "checkout/return");
+
+    // Listings walk the chunks (date added) or the title index and render
+    // every book line; the text is thrown away, so only reading and
+    // formatting the books is timed
+    outputInit(&out);
+    out.color = false;
+    for (int order = 0; order < 2; order++) {
+        phaseInit(&phase);
+        for (int pass = 0; pass < BENCH_LIST_PASSES; pass++) {
+            if (order == 0) {
+                for (const bookChunk* chunk = arena.first; chunk != NULL; chunk = chunk->next) {
+                    for (int slot = 0; slot < chunk->used; slot += BENCH_TIMED_OPS) {
+                        int end = (chunk->used - slot < BENCH_TIMED_OPS) ? chunk->used : slot + BENCH_TIMED_OPS;
+
+                        double started = nowSeconds();
+                        for (int k = slot; k < end; k++) {
+                            benchBookLine(&out, &chunk->books[k]);
+                        }
+                        phaseRecord(&phase, nowSeconds() - started, end - slot);
+                        if (out.length > OUTPUT_BUFFER_SIZE / 2) out.length = 0;
+                    }
+                }
+            } else {
+                for (size_t row = 0; row < titleIdx.count; row += BENCH_TIMED_OPS) {
+                    size_t end = (titleIdx.count - row < BENCH_TIMED_OPS) ? titleIdx.count : row + BENCH_TIMED_OPS;
+
+                    double started = nowSeconds();
+                    for (size_t r = row; r < end; r++) {
+                        benchBookLine(&out, titleIdx.order[r]);
+                    }
+                    phaseRecord(&phase, nowSeconds() - started, (int)(end - row));
+                    if (out.length > OUTPUT_BUFFER_SIZE / 2) out.length = 0;
+                }
+            }
+            out.length = 0;
+        }
+        phaseReport(&phase, order == 0 ? "list added" : "list title");
+    }
+    outputFree(&out);
+
+    if (!found) printf(RED"Some lookups did not find their book.\n"RESET);
+    free(popular);
+    free(nodes);
+    zipfFree(&books);
+    zipfFree(&authors);
+    zipfFree(&words);
+    sortedIndexFree(&titleIdx);
+    sortedIndexFree(&authorIdx);
+    isbnIndexFree(&isbnIdx);
+    freeAllBooks(&arena);
+    return found;
 }
 
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     @DISPLAY FUNCTIONS
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
-void displayAll(book* head, int bookCount) {
-    book* current = head;
-    int i = 1;
-    
-    printf(CYAN"\n<=======================================>\n"
-           "||              ALL BOOKS                 ||\n"
-           "<=======================================>\n\n"RESET);
-    
-    while (current != NULL) {
-        printf(YELLOW"<=======================================>\n"RESET);
-        printf(CYAN"~~> Book #%d\n"RESET, i);
-        printf(CYAN"~~> Title: "RESET);
-        printf(GREEN"%s\n"RESET, current->title);
-        printf(CYAN"~~> Author:  "RESET);
-        printf(GREEN"%s\n"RESET, current->author);
-        printf(CYAN"~~> ISBN: "RESET);
-        printf(GREEN"%s\n"RESET, current->isbn);
-        printf(CYAN"~~> AVAILABILITY: "RESET);
-        printf("%s\n", current->status == AVAILABLE ? GREEN"Available"RESET : RED"Checked Out"RESET);
-        
-        current = current->next;
-        i++;
+// Render one book of a listing as it appears in displayAll
+static void renderBook(outputBuffer* out, const book* node, size_t number)
+{
+    char isbn[ISBN_TEXT_SIZE];
+    bool available = bookGetStatus(node) == AVAILABLE;
+
+    formatISBN(node->isbn, isbn);
+    outputColor(out, YELLOW);
+    outputText(out, "<=======================================>\n");
+    outputColor(out, CYAN);
+    outputText(out, "~~> Book #");
+    outputInt(out, (long long)number);
+    outputBytes(out, "\n", 1);
+    outputColor(out, RESET);
+    outputField(out, "~~> Title: ", node->title, GREEN);
+    outputField(out, "~~> Author:  ", node->author, GREEN);
+    outputField(out, "~~> ISBN: ", isbn, GREEN);
+    outputField(out, "~~> AVAILABILITY: ", available ? "Available" : "Checked Out", available ? GREEN : RED);
+}
+
+// List every book. Records are rendered into an output buffer and written
+// in large blocks, without colors when stdout is redirected.
+void displayAll(const bookArena* arena) {
+    outputBuffer out;
+    size_t i = 1;
+
+    outputInit(&out);
+    outputColor(&out, CYAN);
+    outputText(&out, "\n<=======================================>\n"
+                     "||              ALL BOOKS                 ||\n"
+                     "<=======================================>\n\n");
+    outputColor(&out, RESET);
+
+    // Walk each chunk's books contiguously, in the order they were added
+    for (const bookChunk* chunk = arena->first; chunk != NULL; chunk = chunk->next) {
+        for (int slot = 0; slot < chunk->used; slot++) {
+            renderBook(&out, &chunk->books[slot], i++);
+        }
+    }
+    outputFree(&out);
+}
+
+// Show one page of a listing: `pageSize` rows starting `offset` rows in.
+// The cursor seeks straight to the page, so only its rows are touched.
+static void displayPage(bookCursor* cur, size_t offset, size_t pageSize, const char* orderName)
+{
+    outputBuffer out;
+    size_t total = cursorCount(cur);
+    size_t shown = 0;
+    const book* node;
+
+    outputInit(&out);
+    outputColor(&out, CYAN);
+    outputText(&out, "\n<=======================================>\n"
+                     "||              ALL BOOKS                 ||\n"
+                     "<=======================================>\n");
+    outputText(&out, "~~> Books ");
+    outputInt(&out, (long long)offset + 1);
+    outputText(&out, "-");
+    outputInt(&out, (long long)(offset + pageSize < total ? offset + pageSize : total));
+    outputText(&out, " of ");
+    outputInt(&out, (long long)total);
+    outputText(&out, ", by ");
+    outputText(&out, orderName);
+    outputText(&out, " (page ");
+    outputInt(&out, (long long)(offset / pageSize + 1));
+    outputText(&out, " of ");
+    outputInt(&out, (long long)((total + pageSize - 1) / pageSize));
+    outputText(&out, ")\n\n");
+    outputColor(&out, RESET);
+
+    cursorSeek(cur, offset);
+    while (shown < pageSize && (node = cursorNext(cur)) != NULL) {
+        renderBook(&out, node, offset + shown + 1);
+        shown++;
+    }
+
+    outputColor(&out, YELLOW);
+    outputText(&out, "<=======================================>\n");
+    outputColor(&out, RESET);
+    outputFree(&out);
+}
+
+// Page through the catalog in the order books were added, or by title or
+// author through the sorted indexes
+void browseCatalog(const bookArena* arena, const sortedIndex* titleIdx, const sortedIndex* authorIdx)
+{
+    const sortedIndex* orders[] = {NULL, titleIdx, authorIdx};
+    const char* orderNames[] = {"date added", "title", "author"};
+    int order = 0;
+    size_t pageSize = PAGE_SIZE_DEFAULT;
+    size_t offset = 0;
+    char line[64];
+
+    while (true) {
+        bookCursor cur;
+        indexRange rows = {0, (size_t)arena->count};
+        cursorOpen(&cur, arena, orders[order], rows);
+
+        // Keep the offset on a page boundary inside the listing
+        size_t lastPage = ((cursorCount(&cur) - 1) / pageSize) * pageSize;
+        if (offset > lastPage) offset = lastPage;
+        offset -= offset % pageSize;
+
+        clearScreen();
+        displayHeader();
+        displayPage(&cur, offset, pageSize, orderNames[order]);
+        printf(YELLOW"~~ n - Next\tp - Previous\tg N - Go to book #N\n"
+               "~~ o - Order (date added/title/author)\ts N - Books per page\n"
+               "~~ a - Print all\tq - Back to menu\n|=> "RESET);
+
+        if (fgets(line, sizeof(line), stdin) == NULL) return;
+        if (strchr(line, '\n') == NULL) {
+            int c;
+            while ((c = getchar()) != '\n' && c != EOF);  // Drop the rest of a long line
+        }
+
+        long value = strtol(line + 1, NULL, 10);
+        switch (tolower((unsigned char)line[0])) {
+            case 'n':
+                offset += pageSize;
+                break;
+            case 'p':
+                offset = (offset >= pageSize) ? offset - pageSize : 0;
+                break;
+            case 'g':
+                if (value >= 1) offset = (size_t)(value - 1);
+                break;
+            case 'o':
+                order = (order + 1) % 3;
+                offset = 0;
+                break;
+            case 's':
+                if (value >= 1 && value <= PAGE_SIZE_MAX) pageSize = (size_t)value;
+                break;
+            case 'a':
+                clearScreen();
+                displayHeader();
+                displayAll(arena);
+                waitForKeypress();
+                break;
+            case 'q':
+                return;
+            default:
+                break;
+        }
     }
 }
 
@@ -450,14 +1818,17 @@ void displaySingle(book* node) {
            "||              BOOK DETAILS              ||\n"
            "<=======================================>\n\n"RESET);
     
+    char isbn[ISBN_TEXT_SIZE];
+    formatISBN(node->isbn, isbn);
+
     printf(CYAN"~~> Title: "RESET);
     printf(GREEN"%s\n"RESET, node->title);
     printf(CYAN"~~> Author: "RESET);
     printf(GREEN"%s\n"RESET, node->author);
     printf(CYAN"~~> ISBN: "RESET);
-    printf(GREEN"%s\n"RESET, node->isbn);
+    printf(GREEN"%s\n"RESET, isbn);
     printf(CYAN"~~> AVAILABILITY: "RESET);
-    printf("%s\n", node->status == AVAILABLE ? GREEN"Available"RESET : RED"Checked Out"RESET);
+    printf("%s\n", bookGetStatus(node) == AVAILABLE ? GREEN"Available"RESET : RED"Checked Out"RESET);
     
     printf(YELLOW"<=======================================>\n"RESET);
 }
@@ -479,10 +1850,37 @@ char* getAvailability(enum bookStatus status)
     @CHECKOUT/RETURN FUNCTIONS
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
+// Lock-free read of the status; never waits for a check-out in progress
+enum bookStatus bookGetStatus(const book* node)
+{
+#if defined(__GNUC__)
+    return (enum bookStatus)__atomic_load_n(&node->status, __ATOMIC_ACQUIRE);
+#elif defined(_MSC_VER)
+    return (enum bookStatus)InterlockedCompareExchange((volatile LONG*)&node->status, 0, 0);
+#else
+    return (enum bookStatus)*(const volatile int32_t*)&node->status;
+#endif
+}
+
+// Compare-and-swap the status from `from` to `to`; returns false, changing
+// nothing, if the book is not in status `from`
+bool bookChangeStatus(book* node, enum bookStatus from, enum bookStatus to)
+{
+#if defined(__GNUC__)
+    int32_t expected = (int32_t)from;
+    return __atomic_compare_exchange_n(&node->status, &expected, (int32_t)to, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#elif defined(_MSC_VER)
+    return InterlockedCompareExchange((volatile LONG*)&node->status, (LONG)to, (LONG)from) == (LONG)from;
+#else
+    if (node->status != (int32_t)from) return false;
+    node->status = (int32_t)to;
+    return true;
+#endif
+}
+
 void returnBook(book* node) 
 {
-    if (node->status == CHECKED_OUT) {
-        node->status = AVAILABLE;
+    if (bookChangeStatus(node, CHECKED_OUT, AVAILABLE)) {
         printf(GREEN"\nBook has been returned successfully.\n"RESET);
     } else {
         printf(YELLOW"\nBook is already available.\n"RESET);
@@ -491,8 +1889,7 @@ void returnBook(book* node)
 
 void checkOutBook(book* node) 
 {
-    if (node->status == AVAILABLE) {
-        node->status = CHECKED_OUT;
+    if (bookChangeStatus(node, AVAILABLE, CHECKED_OUT)) {
         printf(GREEN"\nBook has been checked out successfully.\n"RESET);
     } else {
         printf(RED"\nBook is already checked out.\n"RESET);
@@ -6,6 +6,7 @@
 #include <time.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     @MACROS
@@ -29,21 +30,41 @@ typedef struct Book {
     enum bookStatus status;
 } book;
 
+#define ISBN_INDEX_INITIAL_CAPACITY 256 // Must be a power of two
+
+// Open-addressing hash index slot keyed on the 16 ISBN digits
+typedef struct IsbnSlot {
+    uint64_t key;    // ISBN digits packed into a single integer
+    int index;       // Position in the books array, -1 if slot is empty
+} isbnSlot;
+
+// Hash index used for O(1) ISBN lookups at the checkout desk
+typedef struct IsbnIndex {
+    isbnSlot* slots;
+    size_t capacity; // Always a power of two
+    size_t count;
+} isbnIndex;
+
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     @FUNCTION PROTOTYPES
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
 int search ();
-void store (book* books, int* bookCount);
+void store (book* books, int* bookCount, isbnIndex* isbnIdx);
 void displayAll (book* books, int bookCount);
 void displaySingle (book* books, int index);
 void returnBook (book* books, int index);
 void checkOutBook (book* books, int index);
 int searchByTitle (book* books, int bookCount);
 int searchByAuthor (book* books, int bookCount);
-int searchByISBN (book* books, int bookCount);
+int searchByISBN (isbnIndex* isbnIdx);
 char* getAvailability(enum bookStatus status);
 void generateISBN(book* books, int index);
+void isbnIndexInit(isbnIndex* idx);
+void isbnIndexFree(isbnIndex* idx);
+bool isbnIndexInsert(isbnIndex* idx, uint64_t key, int index);
+int isbnIndexFind(const isbnIndex* idx, uint64_t key);
+bool packISBN(const char* isbn, size_t maxLen, uint64_t* key);
 // void typewriter(const char *text, int delay_ms);
 
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -54,6 +75,8 @@ int main ()
 {
     // Declare array that will hold books
     struct Book books[100];
+    isbnIndex isbnIdx;
+    isbnIndexInit(&isbnIdx);
 
     int size = sizeof(books);
     int bookCount = 0;
@@ -65,12 +88,13 @@ int main ()
         printf(YELLOW"<=======================================>\n<< 1 - Store | 2 - Display | 3 - Search >> \n<=======================================>\n|>> "RESET);
         
         usrChoice = getchar();
+        if (usrChoice == EOF) break; // input closed
         while (getchar() != '\n'); // reject non-numeric inputs
 
         switch(usrChoice)
         {
             case '1':
-               store(books, &bookCount);
+               store(books, &bookCount, &isbnIdx);
                break;
             case '2':
                 if (bookCount > 0) displayAll(books, bookCount);
@@ -95,7 +119,7 @@ int main ()
                         if (index > -1) displaySingle(books, index);
                         break;
                     case '3': 
-                        index = searchByISBN(books, bookCount);
+                        index = searchByISBN(&isbnIdx);
                         if (index > -1) displaySingle(books, index);
                         break;
                     default:
@@ -127,6 +151,8 @@ int main ()
 
     }
 
+    isbnIndexFree(&isbnIdx);
+    return 0;
 }
 
 // Generate a unique isbn per book added
@@ -146,6 +172,127 @@ void generateISBN(book* books, int index)
     }
 }
 
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @ISBN INDEX FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+// Pack the 16 digits of an ISBN into one integer, ignoring '-' and spaces
+bool packISBN(const char* isbn, size_t maxLen, uint64_t* key)
+{
+    uint64_t packed = 0;
+    int digits = 0;
+
+    for (size_t i = 0; i < maxLen && isbn[i] != '\0'; i++) {
+        if (isbn[i] >= '0' && isbn[i] <= '9') {
+            if (++digits > 16) return false;
+            packed = packed * 10 + (uint64_t)(isbn[i] - '0');
+        } else if (isbn[i] != '-' && isbn[i] != ' ') {
+            return false;
+        }
+    }
+
+    if (digits != 16) return false;
+    *key = packed;
+    return true;
+}
+
+// Mix the key bits so sequential ISBNs spread across the table
+static size_t isbnHash(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return (size_t)key;
+}
+
+static isbnSlot* allocIsbnSlots(size_t capacity)
+{
+    isbnSlot* slots = (isbnSlot*)malloc(capacity * sizeof(isbnSlot));
+    if (slots == NULL) {
+        printf(RED"Memory allocation failed\n"RESET);
+        exit(1);
+    }
+
+    for (size_t i = 0; i < capacity; i++) {
+        slots[i].index = -1;
+    }
+    return slots;
+}
+
+void isbnIndexInit(isbnIndex* idx)
+{
+    idx->capacity = ISBN_INDEX_INITIAL_CAPACITY;
+    idx->count = 0;
+    idx->slots = allocIsbnSlots(idx->capacity);
+}
+
+void isbnIndexFree(isbnIndex* idx)
+{
+    free(idx->slots);
+    idx->slots = NULL;
+    idx->capacity = 0;
+    idx->count = 0;
+}
+
+// Double the table and re-place every occupied slot
+static void isbnIndexGrow(isbnIndex* idx)
+{
+    size_t newCapacity = idx->capacity * 2;
+    size_t mask = newCapacity - 1;
+    isbnSlot* newSlots = allocIsbnSlots(newCapacity);
+
+    for (size_t i = 0; i < idx->capacity; i++) {
+        if (idx->slots[i].index < 0) continue;
+
+        size_t pos = isbnHash(idx->slots[i].key) & mask;
+        while (newSlots[pos].index >= 0) {
+            pos = (pos + 1) & mask;
+        }
+        newSlots[pos] = idx->slots[i];
+    }
+
+    free(idx->slots);
+    idx->slots = newSlots;
+    idx->capacity = newCapacity;
+}
+
+// Insert a key; returns false if the key is already indexed
+bool isbnIndexInsert(isbnIndex* idx, uint64_t key, int index)
+{
+    // Keep the load factor at or below 1/2 so probe chains stay short
+    if ((idx->count + 1) * 2 > idx->capacity) {
+        isbnIndexGrow(idx);
+    }
+
+    size_t mask = idx->capacity - 1;
+    size_t pos = isbnHash(key) & mask;
+
+    while (idx->slots[pos].index >= 0) {
+        if (idx->slots[pos].key == key) return false;
+        pos = (pos + 1) & mask;
+    }
+
+    idx->slots[pos].key = key;
+    idx->slots[pos].index = index;
+    idx->count++;
+    return true;
+}
+
+// Find the book index stored under a key, or -1 if absent
+int isbnIndexFind(const isbnIndex* idx, uint64_t key)
+{
+    size_t mask = idx->capacity - 1;
+    size_t pos = isbnHash(key) & mask;
+
+    while (idx->slots[pos].index >= 0) {
+        if (idx->slots[pos].key == key) return idx->slots[pos].index;
+        pos = (pos + 1) & mask;
+    }
+    return -1;
+}
+
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     @SEARCH FUNCTIONS
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
@@ -197,21 +344,22 @@ int searchByAuthor (book* books, int bookCount)
     return -1;
 }
 
-// Search book by book isbn
-int searchByISBN (book* books, int bookCount)
+// Search book by book isbn using the hash index
+int searchByISBN (isbnIndex* isbnIdx)
 {
     int index;
+    uint64_t key;
     char isbnToSearch[100];
 
     printf(CYAN"<=======================================>\n|~~ Enter book ISBN to search: "RESET);
     scanf(" %[^\n]", &isbnToSearch);
 
-    for (int i = 0; i < bookCount; i++)
+    if (packISBN(isbnToSearch, sizeof(isbnToSearch), &key))
     {
-        if (strcmp(strlwr(books[i].isbn), strlwr(isbnToSearch)) == 0)
+        index = isbnIndexFind(isbnIdx, key);
+        if (index > -1)
         {
-            printf(GREEN"Book is found on index %d\n"RESET, i);
-            index = i;
+            printf(GREEN"Book is found on index %d\n"RESET, index);
             return index;
         }
     }
@@ -224,7 +372,7 @@ int searchByISBN (book* books, int bookCount)
     @STORE FUNCTION
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
-void store (book* books, int* bookCount) {
+void store (book* books, int* bookCount, isbnIndex* isbnIdx) {
     int count = 0;
     printf(CYAN"<=======================================>\n|~~ Enter the # of books to add: "RESET);
     scanf("%d", &count);
@@ -243,6 +391,12 @@ void store (book* books, int* bookCount) {
 
         books[i].status = AVAILABLE;
 
+        uint64_t key;
+        if (packISBN(books[i].isbn, sizeof(books[i].isbn), &key))
+        {
+            isbnIndexInsert(isbnIdx, key, i);
+        }
+
         *bookCount+=1;
     }
 }
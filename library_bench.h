@@ -0,0 +1,274 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    Synthetic library for --bench, shared by hackathon_improved.c and
+    hackathon_improved_linked-list.c: both generate the same books and
+    queries from the same settings and print the same report, so the two
+    storage designs can be compared line by line. Each program keeps its
+    own runBench, which drives its storage with this workload.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#ifndef LIBRARY_BENCH_H
+#define LIBRARY_BENCH_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <ctype.h>
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @MACROS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#define BENCH_QUERIES 200000       // Timed operations per lookup phase
+#define BENCH_TIMED_OPS 64         // Operations timed together; the clock costs about as much as a lookup
+#define BENCH_INSERT_BATCH 1024    // Books per timed insert; each batch is merged into the sorted indexes once
+#define BENCH_LIST_PASSES 5        // Timed passes over the whole catalog per listing phase
+#define BENCH_VOCABULARY 5000      // Distinct title words
+#define BENCH_BOOKS_PER_AUTHOR 10  // Catalog size / author pool size
+#define BENCH_DEFAULT_ZIPF 0.99    // Default skew; 0 is uniform
+
+// Settings for --bench
+typedef struct BenchConfig {
+    int books;
+    double zipf;       // Skew of title words, authors and queried books
+    uint64_t seed;
+} benchConfig;
+
+// Zipf sampler over ranks [0, n): rank k is drawn with weight 1/(k+1)^s
+typedef struct ZipfTable {
+    double* cdf;       // Running sum of the weights, scaled to end at 1
+    int n;
+} zipfTable;
+
+// Timings of one benchmark phase. Operations are timed in groups, and each
+// sample is a group's time divided by its size.
+typedef struct BenchPhase {
+    double* samples;   // Mean seconds per operation of each group
+    int count;
+    int capacity;
+    long long ops;     // Operations in every group
+    double elapsed;    // Seconds in every group
+} benchPhase;
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    @BENCHMARK FUNCTIONS
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+static void* benchAlloc(size_t size)
+{
+    void* block = malloc(size);
+    if (block == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return block;
+}
+
+// splitmix64: small, fast and the same sequence on every platform
+static uint64_t benchRandom(uint64_t* state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1)
+static double benchUniform(uint64_t* state)
+{
+    return (double)(benchRandom(state) >> 11) / (double)(1ULL << 53);
+}
+
+// Natural log for x >= 1, without pulling in the math library: halve down
+// to [1, 2), then ln(m) = 2 atanh((m - 1) / (m + 1))
+static double benchLog(double x)
+{
+    double result = 0.0;
+    while (x >= 2.0) {
+        x /= 2.0;
+        result += 0.6931471805599453;
+    }
+
+    double y = (x - 1.0) / (x + 1.0);
+    double term = y;
+    for (int k = 1; k < 40; k += 2) {
+        result += 2.0 * term / k;
+        term *= y * y;
+    }
+    return result;
+}
+
+// e^x for x <= 0: Taylor series on x / 2^k, then square k times
+static double benchExp(double x)
+{
+    int squarings = 0;
+    while (x < -0.5) {
+        x /= 2.0;
+        squarings++;
+    }
+
+    double result = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 20; k++) {
+        term *= x / k;
+        result += term;
+    }
+    while (squarings-- > 0) result *= result;
+    return result;
+}
+
+static void zipfInit(zipfTable* table, int n, double s)
+{
+    table->n = n;
+    table->cdf = benchAlloc((size_t)n * sizeof(double));
+
+    double sum = 0.0;
+    for (int k = 0; k < n; k++) {
+        sum += (s == 0.0) ? 1.0 : benchExp(-s * benchLog((double)(k + 1)));
+        table->cdf[k] = sum;
+    }
+    for (int k = 0; k < n; k++) table->cdf[k] /= sum;
+}
+
+// Draw a rank: the first whose running weight passes a uniform draw
+static int zipfNext(const zipfTable* table, uint64_t* state)
+{
+    double u = benchUniform(state);
+    int low = 0;
+    int high = table->n - 1;
+
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (table->cdf[mid] <= u) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static void zipfFree(zipfTable* table)
+{
+    free(table->cdf);
+    table->cdf = NULL;
+}
+
+// A made-up word for a vocabulary rank, e.g. "Kalo" or "Mirune"; every
+// rank gets a different word
+static void benchWord(char* out, size_t size, int rank)
+{
+    static const char* const syllables[16] = {
+        "ka", "lo", "mi", "ne", "ru", "sa", "ti", "vo",
+        "ze", "ba", "do", "fe", "gu", "ha", "ji", "pe"
+    };
+    size_t length = 0;
+
+    do {
+        const char* syllable = syllables[rank % 16];
+        if (length + 3 > size) break;
+        out[length++] = syllable[0];
+        out[length++] = syllable[1];
+        rank /= 16;
+    } while (rank > 0);
+    out[length] = '\0';
+    out[0] = (char)toupper((unsigned char)out[0]);
+}
+
+// A title of 1-4 words, common words drawn more often
+static void benchTitle(char* out, size_t size, const zipfTable* words, uint64_t* state)
+{
+    int count = 1 + (int)(benchRandom(state) % 4);
+    size_t length = 0;
+
+    out[0] = '\0';
+    for (int i = 0; i < count; i++) {
+        char word[16];
+        benchWord(word, sizeof(word), zipfNext(words, state));
+        if (length + strlen(word) + 1 >= size) break;
+        length += (size_t)snprintf(out + length, size - length, "%s%s", i > 0 ? " " : "", word);
+    }
+}
+
+// "First Last" for an author rank, different for every rank
+static void benchAuthor(char* out, size_t size, int rank)
+{
+    char first[16];
+    char last[16];
+
+    benchWord(first, sizeof(first), rank % 61);
+    benchWord(last, sizeof(last), rank / 61 + 7);
+    snprintf(out, size, "%s %s", first, last);
+}
+
+// Shuffled positions 0..n-1, so the most queried books are spread over
+// the catalog instead of being the oldest ones
+static int* benchPermutation(int n, uint64_t* state)
+{
+    int* order = benchAlloc((size_t)n * sizeof(int));
+
+    for (int i = 0; i < n; i++) order[i] = i;
+    for (int i = n - 1; i > 0; i--) {
+        int j = (int)(benchRandom(state) % (uint64_t)(i + 1));
+        int tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+    return order;
+}
+
+static void phaseInit(benchPhase* phase)
+{
+    phase->capacity = 1024;
+    phase->samples = benchAlloc((size_t)phase->capacity * sizeof(double));
+    phase->count = 0;
+    phase->ops = 0;
+    phase->elapsed = 0.0;
+}
+
+// Add a group of `ops` operations that took `seconds` in all
+static void phaseRecord(benchPhase* phase, double seconds, int ops)
+{
+    if (phase->count == phase->capacity) {
+        double* grown = realloc(phase->samples, 2 * (size_t)phase->capacity * sizeof(double));
+        if (grown == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        phase->samples = grown;
+        phase->capacity *= 2;
+    }
+    phase->samples[phase->count++] = seconds / ops;
+    phase->ops += ops;
+    phase->elapsed += seconds;
+}
+
+static int compareSeconds(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// One report line: operations (books for inserts and listings), operations
+// per second, and the median and 99th percentile of the per-group mean
+// time per operation
+static void phaseReport(benchPhase* phase, const char* name)
+{
+    qsort(phase->samples, (size_t)phase->count, sizeof(double), compareSeconds);
+
+    double p50 = phase->samples[(size_t)(phase->count - 1) * 50 / 100];
+    double p99 = phase->samples[(size_t)(phase->count - 1) * 99 / 100];
+    double rate = (phase->elapsed > 0.0) ? phase->ops / phase->elapsed : 0.0;
+
+    printf("%-18s %10lld %14.0f %12.3f %12.3f\n", name, phase->ops, rate, p50 * 1e6, p99 * 1e6);
+    free(phase->samples);
+    phase->samples = NULL;
+}
+
+static void benchHeader(const char* storage, const benchConfig* config)
+{
+    printf("Benchmark: %s storage, %d books, zipf %.2f, seed %llu\n",
+           storage, config->books, config->zipf, (unsigned long long)config->seed);
+    printf("%-18s %10s %14s %12s %12s\n", "phase", "ops", "ops/s", "p50 us", "p99 us");
+}
+
+#endif